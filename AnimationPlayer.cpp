@@ -0,0 +1,211 @@
+#include "AnimationPlayer.h"
+#include "ColorLut.h"
+#include "FrameBufferPool.h"
+#include "ImageProcessor.h"
+
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QThread>
+
+namespace {
+// Browsers treat very short GIF delays as "unspecified" and use 100 ms
+constexpr int MinimumDelayMs = 20;
+constexpr int DefaultDelayMs = 100;
+// Retry interval when the decoder has not caught up yet
+constexpr int StarvedRetryMs = 5;
+}
+
+AnimationPlayer::AnimationPlayer(FrameBufferPool &pool, QObject *parent)
+    : QObject(parent)
+    , m_pool(pool)
+{
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &AnimationPlayer::showNextFrame);
+}
+
+AnimationPlayer::~AnimationPlayer()
+{
+    stop();
+}
+
+bool AnimationPlayer::isAnimated(const QString &path)
+{
+    QImageReader reader(path);
+    return reader.supportsAnimation();
+}
+
+void AnimationPlayer::play(const QString &path, const PropertyTable &properties)
+{
+    stop();
+
+    m_properties = properties;
+    m_decoder = QThread::create([this, path]() { decodeLoop(path); });
+    m_decoder->start();
+    m_timer.start(0);
+}
+
+void AnimationPlayer::stop()
+{
+    m_timer.stop();
+    m_playing = false;
+
+    if (m_decoder) {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_stopping = true;
+            m_notFull.wakeAll();
+        }
+        m_decoder->wait();
+        delete m_decoder;
+        m_decoder = nullptr;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_ring.clear();
+    m_stopping = false;
+    m_currentFrame = QImage();
+    m_processed = QImage();
+}
+
+qint64 AnimationPlayer::bufferedBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 bytes = m_currentFrame.sizeInBytes();
+    if (m_processed.constBits() != m_currentFrame.constBits()) {
+        bytes += m_processed.sizeInBytes();
+    }
+    for (const Frame &frame : m_ring) {
+        bytes += frame.image.sizeInBytes();
+    }
+    return bytes;
+}
+
+void AnimationPlayer::setProperties(const PropertyTable &properties)
+{
+    m_properties = properties;
+    if (m_playing) {
+        renderCurrentFrame();
+    }
+}
+
+void AnimationPlayer::setDisplayColorSpace(const QColorSpace &space)
+{
+    m_displaySpace = space.isValid() ? space : QColorSpace(QColorSpace::SRgb);
+    if (m_playing) {
+        renderCurrentFrame();
+    }
+}
+
+void AnimationPlayer::decodeLoop(const QString &path)
+{
+    // Each pass re-opens the file because not every handler can jump
+    // back to the first frame
+    for (int pass = 1;; ++pass) {
+        QImageReader reader(path);
+        int decoded = 0;
+
+        for (;;) {
+            {
+                QMutexLocker locker(&m_mutex);
+                while (m_ring.size() >= RingCapacity && !m_stopping) {
+                    m_notFull.wait(&m_mutex);
+                }
+                if (m_stopping) {
+                    return;
+                }
+            }
+
+            QImage image = reader.read();
+            if (image.isNull()) {
+                break;
+            }
+
+            const QImage::Format format = ImageProcessor::workingFormat(image);
+            if (image.format() != format) {
+                image = image.convertToFormat(format);
+            }
+
+            int delay = reader.nextImageDelay();
+            if (delay < MinimumDelayMs) {
+                delay = DefaultDelayMs;
+            }
+
+            QMutexLocker locker(&m_mutex);
+            m_ring.enqueue(Frame { image, delay });
+            ++decoded;
+        }
+
+        // Nothing to loop over: a still image, or an unreadable file
+        if (decoded <= 1) {
+            return;
+        }
+
+        // -1 loops forever; otherwise the file plays once plus its loops.
+        // Only known once the handler has read the extension block.
+        const int loops = reader.loopCount();
+        if (loops >= 0 && pass > loops) {
+            return;
+        }
+    }
+}
+
+void AnimationPlayer::showNextFrame()
+{
+    Frame frame;
+    bool haveFrame = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_ring.isEmpty()) {
+            frame = m_ring.dequeue();
+            haveFrame = true;
+            m_notFull.wakeOne();
+        }
+    }
+
+    if (!haveFrame) {
+        if (m_decoder && !m_decoder->isFinished()) {
+            m_timer.start(StarvedRetryMs);
+        } else {
+            finishPlayback();
+        }
+        return;
+    }
+
+    // The first frame is the still the caller already shows; a second one
+    // is what makes this an animation
+    const bool first = m_currentFrame.isNull();
+    m_currentFrame = frame.image;
+    if (!first && !m_playing) {
+        m_playing = true;
+        emit playbackStarted();
+    }
+    if (m_playing) {
+        renderCurrentFrame();
+    }
+    m_timer.start(frame.delayMs);
+}
+
+void AnimationPlayer::finishPlayback()
+{
+    const bool wasPlaying = m_playing;
+    stop();
+    if (wasPlaying) {
+        emit playbackFinished();
+    }
+}
+
+void AnimationPlayer::renderCurrentFrame()
+{
+    // Same processing path as stills, into a reused buffer, converting to
+    // the display's color space in the same pass when it differs
+    const std::shared_ptr<const ColorLut> lut =
+        ColorLut::get(m_currentFrame.colorSpace(), m_displaySpace);
+    if (lut) {
+        m_pool.prepare(m_processed, m_currentFrame.size(), m_currentFrame.format());
+        ImageProcessor::applyRegion(m_currentFrame, m_properties, m_processed,
+                                    m_currentFrame.rect(), QPoint(0, 0), lut.get());
+    } else {
+        ImageProcessor::applyAll(m_currentFrame, m_properties, m_processed, m_pool);
+    }
+    emit frameReady(m_processed);
+}
@@ -0,0 +1,89 @@
+#ifndef ANIMATIONPLAYER_H
+#define ANIMATIONPLAYER_H
+
+#include <QColorSpace>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+#include <QWaitCondition>
+
+#include "ImageProperty.h"
+
+class FrameBufferPool;
+class QThread;
+
+// Plays animated images (GIF, animated WebP) with edits applied per frame.
+// A worker thread decodes ahead of display into a small bounded ring, so
+// memory stays fixed no matter how long or large the animation is; the
+// decoder simply blocks while the ring is full. Playback only starts once a
+// second frame turns up; until then the caller's still stays on screen.
+// Files play as many times as their loop count asks, then stop by
+// themselves.
+class AnimationPlayer : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Decoded frames held ahead of display
+    static constexpr int RingCapacity = 8;
+
+    explicit AnimationPlayer(FrameBufferPool &pool, QObject *parent = nullptr);
+    ~AnimationPlayer();
+
+    // Asks the handler only, without counting frames (which parses the
+    // whole file), so it is true for every GIF. Worth a play() call; a
+    // still in an animated format never starts playing.
+    static bool isAnimated(const QString &path);
+
+    void play(const QString &path, const PropertyTable &properties);
+    void stop();
+    // From playbackStarted() until playbackFinished() or stop()
+    bool isPlaying() const { return m_playing; }
+
+    // Applies to the frame on screen right away and to every later frame;
+    // kept for when playback starts if it has not yet
+    void setProperties(const PropertyTable &properties);
+
+    // Frames are converted to this space, as the renderer does for stills
+    void setDisplayColorSpace(const QColorSpace &space);
+
+    // Pixels held by the ring and the frame on screen; nothing once stopped
+    qint64 bufferedBytes() const;
+
+signals:
+    // The decoder found a second frame; frameReady() follows
+    void playbackStarted();
+    // The last loop has played; the caller's still takes over again
+    void playbackFinished();
+    void frameReady(const QImage &frame);
+
+private:
+    struct Frame {
+        QImage image;
+        int    delayMs = 0;
+    };
+
+    void decodeLoop(const QString &path);
+    void showNextFrame();
+    void renderCurrentFrame();
+    void finishPlayback();
+
+    FrameBufferPool &m_pool;
+    PropertyTable    m_properties;
+    QColorSpace      m_displaySpace { QColorSpace::SRgb };
+
+    mutable QMutex  m_mutex;
+    QWaitCondition  m_notFull;
+    QQueue<Frame>   m_ring;
+    bool            m_stopping = false;
+    QThread        *m_decoder = nullptr;
+
+    QTimer m_timer;
+    bool   m_playing = false;
+    QImage m_currentFrame;
+    QImage m_processed;
+};
+
+#endif // ANIMATIONPLAYER_H
@@ -0,0 +1,104 @@
+#include "AutoAdjust.h"
+#include "ImageProcessor.h"
+
+#include <QtMath>
+
+namespace {
+
+int sliderValue(double value)
+{
+    return qBound(0, qRound(value), 100);
+}
+
+} // namespace
+
+void AutoAdjust::apply(Mode mode, const HistogramStats &stats, PropertyTable &properties)
+{
+    if (!stats.isValid()) {
+        return;
+    }
+
+    const HistogramStats::Channel channels[3] = { HistogramStats::Red, HistogramStats::Green,
+                                                  HistogramStats::Blue };
+
+    switch (mode) {
+    case Mode::Levels: {
+        // Make the per-channel white points meet, then stretch what the
+        // gains leave between the darkest shadow and brightest highlight
+        double high[3];
+        for (int c = 0; c < 3; ++c) {
+            high[c] = stats.percentile(channels[c], 1.0 - Clip);
+        }
+        balance(high, properties);
+
+        double gains[3];
+        ImageProcessor::channelGains(properties.value(PropertyId::Temperature),
+                                     properties.value(PropertyId::Tint), gains);
+        double low = 255.0;
+        double top = 0.0;
+        for (int c = 0; c < 3; ++c) {
+            low = qMin(low, stats.percentile(channels[c], Clip) * gains[c]);
+            top = qMax(top, high[c] * gains[c]);
+        }
+        stretch(low, top, properties);
+        break;
+    }
+    case Mode::Contrast: {
+        // The luma bins are of the unbalanced image; scale them by the
+        // average gain so the current white balance is kept
+        double gains[3];
+        ImageProcessor::channelGains(properties.value(PropertyId::Temperature),
+                                     properties.value(PropertyId::Tint), gains);
+        const double gain = 0.299 * gains[0] + 0.587 * gains[1] + 0.114 * gains[2];
+        stretch(stats.percentile(HistogramStats::Luma, Clip) * gain,
+                stats.percentile(HistogramStats::Luma, 1.0 - Clip) * gain, properties);
+        break;
+    }
+    case Mode::WhiteBalance: {
+        double means[3];
+        for (int c = 0; c < 3; ++c) {
+            means[c] = stats.trimmedMean(channels[c], Clip, 1.0 - Clip);
+        }
+        balance(means, properties);
+        break;
+    }
+    }
+}
+
+void AutoAdjust::stretch(double low, double high, PropertyTable &properties)
+{
+    if (high - low < 1.0) {
+        return;  // flat image, nothing to stretch
+    }
+
+    // Contrast scales around 128 and brightness shifts afterwards; solve
+    // for low -> 0 and high -> 255 using the factor the slider can
+    // actually express, so the brightness makes up for its rounding
+    const int contrast = sliderValue(255.0 / (high - low) * 50.0);
+    const double factor = ImageProcessor::contrastFactor(contrast);
+    const double offset = 127.5 - ((low + high) / 2.0 - 128.0) * factor - 128.0;
+
+    properties[PropertyId::Contrast].setValue(contrast);
+    properties[PropertyId::Brightness].setValue(sliderValue(offset / 2.55 + 50.0));
+}
+
+void AutoAdjust::balance(const double target[3], PropertyTable &properties)
+{
+    // Temperature moves red and blue in opposite directions and tint
+    // moves green alone (see ImageProcessor::channelGains), so the red to
+    // blue ratio fixes temperature and the green gain then fixes tint
+    if (target[0] <= 0.0 || target[1] <= 0.0 || target[2] <= 0.0) {
+        return;
+    }
+
+    const double ratio = target[2] / target[0];
+    const double warm = qBound(-1.0, 2.0 * (ratio - 1.0) / (ratio + 1.0), 1.0);
+    const int temperature = sliderValue(50.0 + 50.0 * warm);
+
+    const double red = 1.0 + 0.5 * (temperature - 50) / 50.0;
+    const double level = red * target[0];
+    const double magenta = qBound(-1.0, 2.0 * (1.0 - level / target[1]), 1.0);
+
+    properties[PropertyId::Temperature].setValue(temperature);
+    properties[PropertyId::Tint].setValue(sliderValue(50.0 + 50.0 * magenta));
+}
@@ -0,0 +1,31 @@
+#ifndef AUTOADJUST_H
+#define AUTOADJUST_H
+
+#include "HistogramStats.h"
+#include "ImageProperty.h"
+
+// Picks slider values from an image's histogram. Each mode reads a few
+// percentiles, so it costs O(256) whatever the image size and can be run
+// over a whole selection without decoding anything that already has
+// cached statistics.
+class AutoAdjust
+{
+public:
+    enum class Mode {
+        Levels,        // white point per channel, then stretch to full range
+        Contrast,      // stretch luma to full range, keeping the color balance
+        WhiteBalance,  // gray world: equal channel means
+    };
+
+    // Fraction of pixels allowed to clip at each end
+    static constexpr double Clip = 0.005;
+
+    // Sets the properties `mode` controls and leaves the others alone
+    static void apply(Mode mode, const HistogramStats &stats, PropertyTable &properties);
+
+private:
+    static void stretch(double low, double high, PropertyTable &properties);
+    static void balance(const double target[3], PropertyTable &properties);
+};
+
+#endif // AUTOADJUST_H
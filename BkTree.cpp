@@ -0,0 +1,57 @@
+#include "BkTree.h"
+#include "PerceptualHash.h"
+
+void BkTree::insert(quint64 hash, int id)
+{
+    const int newIndex = int(m_nodes.size());
+    m_nodes.push_back(Node { hash, id, {} });
+
+    if (newIndex == 0) {
+        return;
+    }
+
+    int current = 0;
+    for (;;) {
+        const int d = PerceptualHash::distance(hash, m_nodes[current].hash);
+
+        int next = -1;
+        for (const auto &child : m_nodes[current].children) {
+            if (child.first == d) {
+                next = child.second;
+                break;
+            }
+        }
+
+        if (next < 0) {
+            m_nodes[current].children.emplace_back(d, newIndex);
+            return;
+        }
+        current = next;
+    }
+}
+
+QVector<int> BkTree::query(quint64 hash, int maxDistance) const
+{
+    QVector<int> result;
+    if (m_nodes.empty()) {
+        return result;
+    }
+
+    std::vector<int> pending { 0 };
+    while (!pending.empty()) {
+        const Node &node = m_nodes[pending.back()];
+        pending.pop_back();
+
+        const int d = PerceptualHash::distance(hash, node.hash);
+        if (d <= maxDistance) {
+            result.push_back(node.id);
+        }
+
+        for (const auto &child : node.children) {
+            if (child.first >= d - maxDistance && child.first <= d + maxDistance) {
+                pending.push_back(child.second);
+            }
+        }
+    }
+    return result;
+}
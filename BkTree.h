@@ -0,0 +1,32 @@
+#ifndef BKTREE_H
+#define BKTREE_H
+
+#include <QVector>
+
+#include <vector>
+
+// Burkhard-Keller tree over 64-bit hashes with Hamming distance. Children
+// are keyed by their distance to the parent, so by the triangle inequality
+// a radius query only descends into children whose key lies within
+// [d - radius, d + radius], which skips most of the tree for small radii.
+class BkTree
+{
+public:
+    void insert(quint64 hash, int id);
+
+    // Ids of all inserted hashes within maxDistance of `hash`
+    QVector<int> query(quint64 hash, int maxDistance) const;
+
+    int size() const { return int(m_nodes.size()); }
+
+private:
+    struct Node {
+        quint64 hash;
+        int     id;
+        std::vector<std::pair<int, int>> children; // (distance, node index)
+    };
+
+    std::vector<Node> m_nodes;
+};
+
+#endif // BKTREE_H
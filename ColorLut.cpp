@@ -0,0 +1,84 @@
+#include "ColorLut.h"
+
+#include <QColorTransform>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRgba64>
+#include <QVector>
+
+namespace {
+
+// Compiled tables are small (under 1 MB each), but a folder of images
+// with many different profiles should not keep all of them
+constexpr int CacheCapacity = 8;
+
+QColorSpace orSrgb(const QColorSpace &space)
+{
+    return space.isValid() ? space : QColorSpace(QColorSpace::SRgb);
+}
+
+} // namespace
+
+std::shared_ptr<const ColorLut> ColorLut::get(const QColorSpace &source,
+                                              const QColorSpace &target)
+{
+    const QColorSpace from = orSrgb(source);
+    if (!target.isValid() || from == target) {
+        return nullptr;
+    }
+
+    static QMutex mutex;
+    static QVector<std::shared_ptr<const ColorLut>> cache;  // most recent last
+
+    QMutexLocker locker(&mutex);
+    for (int i = 0; i < cache.size(); ++i) {
+        if (cache[i]->source() == from && cache[i]->target() == target) {
+            std::shared_ptr<const ColorLut> lut = cache[i];
+            cache.removeAt(i);
+            cache.push_back(lut);
+            return lut;
+        }
+    }
+
+    auto lut = std::make_shared<const ColorLut>(from, target);
+    if (cache.size() >= CacheCapacity) {
+        cache.removeFirst();
+    }
+    cache.push_back(lut);
+    return lut;
+}
+
+ColorLut::ColorLut(const QColorSpace &source, const QColorSpace &target)
+    : m_source(source)
+    , m_target(target)
+{
+    // Run every grid node through the real transform once
+    const QColorTransform transform = source.transformationToColorSpace(target);
+    const auto level = [](int i) { return quint16((i * 65535 + (GridSize - 1) / 2) / (GridSize - 1)); };
+
+    m_nodes.resize(size_t(GridSize) * GridSize * GridSize);
+    Node *node = m_nodes.data();
+    for (int r = 0; r < GridSize; ++r) {
+        for (int g = 0; g < GridSize; ++g) {
+            for (int b = 0; b < GridSize; ++b) {
+                const QRgba64 out = transform.map(QRgba64::fromRgba64(level(r), level(g),
+                                                                      level(b), 65535));
+                *node++ = Node { { out.red(), out.green(), out.blue(), 0 } };
+            }
+        }
+    }
+
+    // Cell and fixed-point fraction for each input value; the last value
+    // sits at the far end of the last cell rather than in a cell of its own
+    m_axis.resize(65536);
+    for (int v = 0; v < 65536; ++v) {
+        const qint64 position = qint64(v) * (GridSize - 1);
+        int index = int(position / 65535);
+        int fraction = int(((position - qint64(index) * 65535) * One + 32767) / 65535);
+        if (index >= GridSize - 1) {
+            index = GridSize - 2;
+            fraction = One;
+        }
+        m_axis[v] = Axis { quint16(index), quint16(fraction) };
+    }
+}
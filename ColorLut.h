@@ -0,0 +1,113 @@
+#ifndef COLORLUT_H
+#define COLORLUT_H
+
+#include <QColorSpace>
+#include <QtGlobal>
+
+#include <memory>
+#include <vector>
+
+// A color space conversion compiled once into a 3D lookup table, so that
+// applying it per pixel costs a few multiply-adds instead of a full ICC
+// transform. Values are interpolated tetrahedrally between the grid nodes
+// in 16-bit fixed point; each node is padded to four lanes so the three
+// channels are computed together.
+class ColorLut
+{
+public:
+    static constexpr int GridSize = 33;
+
+    // Shared, compiled on first use and kept for later calls. Null when
+    // the conversion is the identity or either space is unusable; images
+    // without an embedded profile are taken to be sRGB.
+    static std::shared_ptr<const ColorLut> get(const QColorSpace &source,
+                                               const QColorSpace &target);
+
+    const QColorSpace &source() const { return m_source; }
+    const QColorSpace &target() const { return m_target; }
+
+    // Converts one 16-bit RGB triple in place
+    inline void map(quint16 &r, quint16 &g, quint16 &b) const;
+
+    ColorLut(const QColorSpace &source, const QColorSpace &target);
+
+private:
+    static constexpr int FractionBits = 12;
+    static constexpr int One = 1 << FractionBits;
+
+    struct alignas(16) Node {
+        qint32 c[4];
+    };
+
+    // Grid cell and position inside it for every 16-bit input value
+    struct Axis {
+        quint16 index;
+        quint16 fraction;
+    };
+
+    QColorSpace       m_source;
+    QColorSpace       m_target;
+    std::vector<Node> m_nodes;   // blue varies fastest
+    std::vector<Axis> m_axis;
+};
+
+inline void ColorLut::map(quint16 &r, quint16 &g, quint16 &b) const
+{
+    constexpr int X = GridSize * GridSize;
+    constexpr int Y = GridSize;
+    constexpr int Z = 1;
+
+    const Axis ax = m_axis[r];
+    const Axis ay = m_axis[g];
+    const Axis az = m_axis[b];
+    const int fx = ax.fraction;
+    const int fy = ay.fraction;
+    const int fz = az.fraction;
+
+    const Node *base = m_nodes.data() + ax.index * X + ay.index * Y + az.index;
+
+    // The cube splits into six tetrahedra along its diagonal; walk from
+    // the origin corner to the far one along the edges of the one holding
+    // the point, largest fraction first
+    const Node *first;
+    const Node *second;
+    int w0, w1, w2;
+    if (fx >= fy) {
+        if (fy >= fz) {
+            first = base + X;  second = base + X + Y;  w0 = fx; w1 = fy; w2 = fz;
+        } else if (fx >= fz) {
+            first = base + X;  second = base + X + Z;  w0 = fx; w1 = fz; w2 = fy;
+        } else {
+            first = base + Z;  second = base + X + Z;  w0 = fz; w1 = fx; w2 = fy;
+        }
+    } else {
+        if (fz >= fy) {
+            first = base + Z;  second = base + Y + Z;  w0 = fz; w1 = fy; w2 = fx;
+        } else if (fx >= fz) {
+            first = base + Y;  second = base + X + Y;  w0 = fy; w1 = fx; w2 = fz;
+        } else {
+            first = base + Y;  second = base + Y + Z;  w0 = fy; w1 = fz; w2 = fx;
+        }
+    }
+
+    const Node &c0 = base[0];
+    const Node &c1 = *first;
+    const Node &c2 = *second;
+    const Node &c3 = base[X + Y + Z];
+    const int k0 = One - w0;
+    const int k1 = w0 - w1;
+    const int k2 = w1 - w2;
+    const int k3 = w2;
+
+    qint32 out[4];
+    for (int lane = 0; lane < 4; ++lane) {
+        out[lane] = (c0.c[lane] * k0 + c1.c[lane] * k1 + c2.c[lane] * k2 +
+                     c3.c[lane] * k3 + One / 2) >> FractionBits;
+    }
+
+    r = quint16(qBound(0, out[0], 65535));
+    g = quint16(qBound(0, out[1], 65535));
+    b = quint16(qBound(0, out[2], 65535));
+}
+
+#endif // COLORLUT_H
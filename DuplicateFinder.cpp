@@ -0,0 +1,177 @@
+#include "DuplicateFinder.h"
+#include "BkTree.h"
+#include "ParallelFor.h"
+#include "PerceptualHash.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+DuplicateFinder::DuplicateFinder(QObject *parent)
+    : QObject(parent)
+{
+    // Single coordinator thread; the hashing itself fans out to the global pool
+    m_pool.setMaxThreadCount(1);
+}
+
+DuplicateFinder::~DuplicateFinder()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void DuplicateFinder::start(const QString &folderPath, const QStringList &filePaths,
+                            int maxDistance)
+{
+    if (isRunning()) {
+        return;
+    }
+
+    m_running   = true;
+    m_cancelled = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_groups.clear();
+    }
+
+    m_pool.start([this, folderPath, filePaths, maxDistance]() {
+        run(folderPath, filePaths, maxDistance);
+        m_running = false;
+        emit finished();
+    });
+}
+
+void DuplicateFinder::cancel()
+{
+    m_cancelled = true;
+}
+
+QVector<QVector<int>> DuplicateFinder::groups() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_groups;
+}
+
+void DuplicateFinder::run(const QString &folderPath, const QStringList &filePaths,
+                          int maxDistance)
+{
+    // Most hashes are there already: the thumbnail loader stores one for
+    // every thumbnail it decodes
+    const int count = filePaths.size();
+    const PerceptualHashCache::Entries cache = PerceptualHashCache::load(folderPath);
+
+    std::vector<PerceptualHashCache::Entry> entries(count, PerceptualHashCache::Entry { 0, 0, 0 });
+    std::vector<char> valid(count, 0);
+    QVector<int> pending;
+
+    for (int i = 0; i < count; ++i) {
+        const QFileInfo info(filePaths[i]);
+        entries[i].size     = info.size();
+        entries[i].modified = info.lastModified().toMSecsSinceEpoch();
+
+        auto it = cache.constFind(info.fileName());
+        if (it != cache.constEnd() &&
+            it->size == entries[i].size && it->modified == entries[i].modified) {
+            entries[i].hash = it->hash;
+            valid[i] = 1;
+        } else {
+            pending.push_back(i);
+        }
+    }
+
+    std::atomic<int> hashed { count - int(pending.size()) };
+    emit progressChanged(hashed.load(), count);
+
+    parallelFor(int(pending.size()), [&](int k) {
+        if (m_cancelled.load()) {
+            return;
+        }
+
+        const int i = pending[k];
+        quint64 hash = 0;
+        if (PerceptualHash::computeForFile(filePaths[i], hash)) {
+            entries[i].hash = hash;
+            valid[i] = 1;
+        }
+
+        const int done = ++hashed;
+        if (done % 32 == 0 || done == count) {
+            emit progressChanged(done, count);
+        }
+    });
+
+    // Kept even when cancelled, so the next scan starts from here
+    PerceptualHashCache::Entries computed;
+    for (int i : std::as_const(pending)) {
+        if (valid[i]) {
+            computed.insert(QFileInfo(filePaths[i]).fileName(), entries[i]);
+        }
+    }
+    PerceptualHashCache::merge(folderPath, computed);
+
+    if (m_cancelled.load()) {
+        return;
+    }
+
+    BkTree tree;
+    for (int i = 0; i < count; ++i) {
+        if (valid[i]) {
+            tree.insert(entries[i].hash, i);
+        }
+    }
+
+    // The tree is read-only from here, so the radius queries run in parallel
+    std::vector<QVector<int>> neighbours(count);
+    parallelFor(count, [&](int i) {
+        if (valid[i]) {
+            neighbours[i] = tree.query(entries[i].hash, maxDistance);
+        }
+    });
+
+    std::vector<int> parent(count);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&parent](int i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+
+    for (int i = 0; i < count; ++i) {
+        for (int j : neighbours[i]) {
+            const int a = find(i);
+            const int b = find(j);
+            if (a != b) {
+                parent[qMax(a, b)] = qMin(a, b);
+            }
+        }
+    }
+
+    QHash<int, QVector<int>> byRoot;
+    for (int i = 0; i < count; ++i) {
+        if (valid[i]) {
+            byRoot[find(i)].push_back(i);
+        }
+    }
+
+    QVector<QVector<int>> groups;
+    for (const QVector<int> &group : byRoot) {
+        if (group.size() > 1) {
+            groups.push_back(group);
+        }
+    }
+    std::sort(groups.begin(), groups.end(),
+              [](const QVector<int> &a, const QVector<int> &b) {
+                  return a.size() != b.size() ? a.size() > b.size()
+                                              : a.first() < b.first();
+              });
+
+    QMutexLocker locker(&m_mutex);
+    m_groups = groups;
+}
@@ -0,0 +1,52 @@
+#ifndef DUPLICATEFINDER_H
+#define DUPLICATEFINDER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+
+// Groups near-identical images of a folder. Perceptual hashes come from the
+// folder's hash cache, which the thumbnail loader fills as it decodes;
+// files without one are hashed here in parallel and added to it, so
+// re-running on an unchanged folder only reads the cache. Grouping then
+// uses a BK-tree radius query per image instead of comparing every pair.
+class DuplicateFinder : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Hashes at most this many bits apart are considered the same picture
+    static constexpr int DefaultMaxDistance = 8;
+
+    explicit DuplicateFinder(QObject *parent = nullptr);
+    ~DuplicateFinder();
+
+    void start(const QString &folderPath, const QStringList &filePaths,
+               int maxDistance = DefaultMaxDistance);
+    void cancel();
+    bool isRunning() const { return m_running.load(); }
+    bool wasCancelled() const { return m_cancelled.load(); }
+
+    // Groups of two or more indexes into the started file list, largest first
+    QVector<QVector<int>> groups() const;
+
+signals:
+    void progressChanged(int hashed, int total);
+    void finished();
+
+private:
+    void run(const QString &folderPath, const QStringList &filePaths, int maxDistance);
+
+    mutable QMutex        m_mutex;
+    QVector<QVector<int>> m_groups;
+    std::atomic<bool>     m_running { false };
+    std::atomic<bool>     m_cancelled { false };
+    QThreadPool           m_pool;
+};
+
+#endif // DUPLICATEFINDER_H
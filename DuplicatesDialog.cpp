@@ -0,0 +1,68 @@
+#include "DuplicatesDialog.h"
+
+#include <QDialogButtonBox>
+#include <QFileInfo>
+#include <QHeaderView>
+#include <QLabel>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+DuplicatesDialog::DuplicatesDialog(const QVector<QStringList> &groups, QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle(tr("Duplicates"));
+    resize(420, 520);
+
+    QLabel *summary = new QLabel(this);
+    summary->setWordWrap(true);
+    summary->setStyleSheet("QLabel { color: #64748b; }");
+
+    int duplicateCount = 0;
+    for (const QStringList &group : groups) {
+        duplicateCount += group.size();
+    }
+    summary->setText(groups.isEmpty()
+                         ? tr("No near-identical images were found.")
+                         : tr("%1 images in %2 groups look alike. "
+                              "Double-click an image to show it.")
+                               .arg(duplicateCount)
+                               .arg(groups.size()));
+
+    m_tree = new QTreeWidget(this);
+    m_tree->setHeaderHidden(true);
+    m_tree->setRootIsDecorated(true);
+    m_tree->header()->setSectionResizeMode(QHeaderView::Stretch);
+
+    for (int g = 0; g < groups.size(); ++g) {
+        auto *groupItem = new QTreeWidgetItem(m_tree);
+        groupItem->setText(0, tr("Group %1 (%2 images)").arg(g + 1).arg(groups[g].size()));
+        groupItem->setFlags(Qt::ItemIsEnabled);
+
+        for (const QString &path : groups[g]) {
+            auto *imageItem = new QTreeWidgetItem(groupItem);
+            imageItem->setText(0, QFileInfo(path).fileName());
+            imageItem->setToolTip(0, path);
+            imageItem->setData(0, Qt::UserRole, path);
+        }
+    }
+    m_tree->expandAll();
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    connect(m_tree, &QTreeWidget::itemActivated, this, &DuplicatesDialog::onItemActivated);
+
+    auto *layout = new QVBoxLayout(this);
+    layout->addWidget(summary);
+    layout->addWidget(m_tree, 1);
+    layout->addWidget(buttons);
+}
+
+void DuplicatesDialog::onItemActivated(QTreeWidgetItem *item, int column)
+{
+    Q_UNUSED(column);
+
+    const QString path = item ? item->data(0, Qt::UserRole).toString() : QString();
+    if (!path.isEmpty()) {
+        emit imageActivated(path);
+    }
+}
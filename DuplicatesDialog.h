@@ -0,0 +1,29 @@
+#ifndef DUPLICATESDIALOG_H
+#define DUPLICATESDIALOG_H
+
+#include <QDialog>
+#include <QStringList>
+#include <QVector>
+
+class QTreeWidget;
+class QTreeWidgetItem;
+
+class DuplicatesDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    // Each group lists the full paths of images that look alike
+    explicit DuplicatesDialog(const QVector<QStringList> &groups,
+                              QWidget *parent = nullptr);
+
+signals:
+    void imageActivated(const QString &path);
+
+private:
+    void onItemActivated(QTreeWidgetItem *item, int column);
+
+    QTreeWidget *m_tree = nullptr;
+};
+
+#endif // DUPLICATESDIALOG_H
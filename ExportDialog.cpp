@@ -0,0 +1,83 @@
+#include "ExportDialog.h"
+#include "ImageExporter.h"
+
+#include <QComboBox>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QSlider>
+#include <QVBoxLayout>
+
+ExportDialog::ExportDialog(int imageCount, QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle(imageCount > 1 ? tr("Export %1 Images").arg(imageCount)
+                                  : tr("Export Image"));
+
+    m_formatCombo = new QComboBox(this);
+    for (const QString &format : ImageExporter::availableFormats()) {
+        m_formatCombo->addItem(format.toUpper(), format);
+    }
+
+    m_qualitySlider = new QSlider(Qt::Horizontal, this);
+    m_qualitySlider->setRange(1, 100);
+    m_qualitySlider->setValue(90);
+    m_qualityLabel = new QLabel(QString::number(m_qualitySlider->value()), this);
+    m_qualityLabel->setMinimumWidth(32);
+
+    auto *qualityRow = new QHBoxLayout;
+    qualityRow->addWidget(m_qualitySlider, 1);
+    qualityRow->addWidget(m_qualityLabel);
+
+    m_hintLabel = new QLabel(this);
+    m_hintLabel->setWordWrap(true);
+    m_hintLabel->setStyleSheet("QLabel { color: #64748b; }");
+
+    auto *form = new QFormLayout;
+    form->addRow(tr("Format"), m_formatCombo);
+    form->addRow(tr("Quality"), qualityRow);
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    auto *layout = new QVBoxLayout(this);
+    layout->addLayout(form);
+    layout->addWidget(m_hintLabel);
+    layout->addWidget(buttons);
+
+    connect(m_qualitySlider, &QSlider::valueChanged, this, [this](int value) {
+        m_qualityLabel->setText(QString::number(value));
+    });
+    connect(m_formatCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &ExportDialog::updateQualityState);
+
+    updateQualityState();
+}
+
+QString ExportDialog::format() const
+{
+    return m_formatCombo->currentData().toString();
+}
+
+int ExportDialog::quality() const
+{
+    return m_qualitySlider->value();
+}
+
+void ExportDialog::updateQualityState()
+{
+    const QString current = format();
+    const bool lossy = current == "jpg" || current == "webp";
+
+    m_qualitySlider->setEnabled(current != "ppm");
+    if (current == "ppm") {
+        m_hintLabel->setText(tr("Uncompressed. Rendered strip by strip, so it also works "
+                                "for images too large to open at full size."));
+    } else if (lossy) {
+        m_hintLabel->setText(tr("Higher quality gives larger files."));
+    } else {
+        m_hintLabel->setText(tr("Lossless. Quality trades encoding speed for file size."));
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef EXPORTDIALOG_H
+#define EXPORTDIALOG_H
+
+#include <QDialog>
+
+class QComboBox;
+class QLabel;
+class QSlider;
+
+class ExportDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit ExportDialog(int imageCount, QWidget *parent = nullptr);
+
+    QString format() const;
+    int quality() const;
+
+private:
+    void updateQualityState();
+
+    QComboBox *m_formatCombo = nullptr;
+    QSlider   *m_qualitySlider = nullptr;
+    QLabel    *m_qualityLabel = nullptr;
+    QLabel    *m_hintLabel = nullptr;
+};
+
+#endif // EXPORTDIALOG_H
@@ -0,0 +1,17 @@
+#include "FolderCache.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QStandardPaths>
+
+QString FolderCache::filePath(const QString &folderPath, const QString &name)
+{
+    const QByteArray key = QCryptographicHash::hash(
+        QDir(folderPath).absolutePath().toUtf8(),
+        QCryptographicHash::Sha1).toHex();
+
+    QDir dir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+    const QString subdir = "folders/" + QString::fromLatin1(key);
+    dir.mkpath(subdir);
+    return dir.filePath(subdir + "/" + name);
+}
@@ -0,0 +1,15 @@
+#ifndef FOLDERCACHE_H
+#define FOLDERCACHE_H
+
+#include <QString>
+
+// Per-folder data derived from the images (hashes, metadata) is kept in
+// the user's cache directory rather than next to the photos themselves.
+class FolderCache
+{
+public:
+    // Path of the named cache file for a folder; the directory is created
+    static QString filePath(const QString &folderPath, const QString &name);
+};
+
+#endif // FOLDERCACHE_H
@@ -0,0 +1,74 @@
+#include "FrameBufferPool.h"
+
+FrameBufferPool::FrameBufferPool(int maxIdleBuffers)
+    : m_maxIdle(maxIdleBuffers)
+{
+    m_idle.reserve(maxIdleBuffers);
+}
+
+void FrameBufferPool::prepare(QImage &buffer, const QSize &size, QImage::Format format)
+{
+    // isDetached() is false while anyone else (e.g. the original image the
+    // buffer was initialised from) still shares the data; writing would copy
+    if (!buffer.isNull() && buffer.isDetached() &&
+        buffer.size() == size && buffer.format() == format) {
+        ++m_reuses;
+        return;
+    }
+
+    recycle(buffer);
+
+    for (int i = 0; i < m_idle.size(); ++i) {
+        const QImage &idle = m_idle[i];
+        if (idle.size() == size && idle.format() == format) {
+            buffer = m_idle.takeAt(i);
+            ++m_reuses;
+            return;
+        }
+    }
+
+    buffer = QImage(size, format);
+    ++m_allocations;
+}
+
+void FrameBufferPool::prepare(QPixmap &buffer, const QSize &size)
+{
+    if (!buffer.isNull() && buffer.isDetached() && buffer.size() == size) {
+        ++m_reuses;
+        return;
+    }
+
+    buffer = QPixmap(size);
+    ++m_allocations;
+}
+
+void FrameBufferPool::recycle(QImage &buffer)
+{
+    if (!buffer.isNull() && buffer.isDetached() && m_maxIdle > 0) {
+        if (m_idle.size() >= m_maxIdle) {
+            m_idle.removeFirst();
+        }
+        m_idle.push_back(buffer);
+    }
+    buffer = QImage();
+}
+
+void FrameBufferPool::clear()
+{
+    m_idle.clear();
+}
+
+qint64 FrameBufferPool::idleBytes() const
+{
+    qint64 bytes = 0;
+    for (const QImage &idle : m_idle) {
+        bytes += idle.sizeInBytes();
+    }
+    return bytes;
+}
+
+void FrameBufferPool::resetCounters()
+{
+    m_allocations = 0;
+    m_reuses      = 0;
+}
@@ -0,0 +1,42 @@
+#ifndef FRAMEBUFFERPOOL_H
+#define FRAMEBUFFERPOOL_H
+
+#include <QImage>
+#include <QPixmap>
+#include <QSize>
+#include <QVector>
+
+// Keeps render targets alive between frames so that repeated renders of the
+// same image write into storage that already exists instead of allocating
+// a new full-size buffer on every slider tick.
+class FrameBufferPool
+{
+public:
+    explicit FrameBufferPool(int maxIdleBuffers = 4);
+
+    // Make `buffer` a writable, unshared image of the given size and format.
+    // Its current storage is kept when it fits, otherwise an idle pooled
+    // buffer is taken, and only as a last resort new memory is allocated.
+    void prepare(QImage &buffer, const QSize &size, QImage::Format format);
+    void prepare(QPixmap &buffer, const QSize &size);
+
+    // Hand a buffer's storage back to the pool, leaving `buffer` null
+    void recycle(QImage &buffer);
+    void clear();
+
+    // Memory held by idle buffers
+    qint64 idleBytes() const;
+
+    // Counters for checking that steady-state rendering does not allocate
+    quint64 allocations() const { return m_allocations; }
+    quint64 reuses() const      { return m_reuses; }
+    void resetCounters();
+
+private:
+    QVector<QImage> m_idle;
+    int     m_maxIdle;
+    quint64 m_allocations = 0;
+    quint64 m_reuses      = 0;
+};
+
+#endif // FRAMEBUFFERPOOL_H
@@ -0,0 +1,142 @@
+#include "HistogramLoader.h"
+#include "FolderCache.h"
+#include "ParallelFor.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+constexpr quint32 CacheMagic   = 0x48495354; // "HIST"
+constexpr quint32 CacheVersion = 1;
+const char *const CacheName    = "histograms.dat";
+}
+
+HistogramLoader::HistogramLoader(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<HistogramStats>();
+
+    // Single coordinator thread, so batches run in order and each one sees
+    // the cache the previous one saved; decoding fans out to the global pool
+    m_pool.setMaxThreadCount(1);
+}
+
+HistogramLoader::~HistogramLoader()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void HistogramLoader::start(const QString &folderPath, const QStringList &paths,
+                            const QVector<int> &ids)
+{
+    const int generation = m_generation.load();
+    m_pool.start([this, folderPath, paths, ids, generation]() {
+        run(folderPath, paths, ids, generation);
+    });
+}
+
+void HistogramLoader::cancel()
+{
+    ++m_generation;
+}
+
+void HistogramLoader::run(const QString &folderPath, const QStringList &paths,
+                          const QVector<int> &ids, int generation)
+{
+    if (m_generation.load() != generation) {
+        return;
+    }
+
+    const QString cacheFile = FolderCache::filePath(folderPath, CacheName);
+    HistogramCache cache = loadCache(cacheFile);
+
+    const int count = paths.size();
+    QVector<CachedHistogram> entries(count, CachedHistogram { 0, 0, HistogramStats() });
+    QVector<int> pending;
+
+    for (int i = 0; i < count; ++i) {
+        const QFileInfo info(paths[i]);
+        entries[i].size     = info.size();
+        entries[i].modified = info.lastModified().toMSecsSinceEpoch();
+
+        auto it = cache.constFind(info.fileName());
+        if (it != cache.constEnd() &&
+            it->size == entries[i].size && it->modified == entries[i].modified) {
+            emit histogramReady(generation, ids[i], it->histogram);
+        } else {
+            pending.push_back(i);
+        }
+    }
+
+    CachedHistogram *out = entries.data();
+    parallelFor(int(pending.size()), [&](int k) {
+        if (m_generation.load() != generation) {
+            return;
+        }
+        const int i = pending[k];
+        out[i].histogram = HistogramStats::computeForFile(paths[i]);
+        emit histogramReady(generation, ids[i], out[i].histogram);
+    });
+
+    bool changed = false;
+    for (int i : pending) {
+        if (entries[i].histogram.isValid()) {
+            cache.insert(QFileInfo(paths[i]).fileName(), entries[i]);
+            changed = true;
+        }
+    }
+    if (changed) {
+        saveCache(cacheFile, cache);
+    }
+}
+
+HistogramLoader::HistogramCache HistogramLoader::loadCache(const QString &cacheFile)
+{
+    HistogramCache cache;
+
+    QFile file(cacheFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return cache;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 count = 0;
+    in >> magic >> version >> count;
+    if (magic != CacheMagic || version != CacheVersion || count < 0) {
+        return cache;
+    }
+
+    cache.reserve(count);
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString name;
+        CachedHistogram entry;
+        in >> name >> entry.size >> entry.modified >> entry.histogram;
+        cache.insert(name, entry);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        cache.clear();
+    }
+    return cache;
+}
+
+void HistogramLoader::saveCache(const QString &cacheFile, const HistogramCache &cache)
+{
+    QSaveFile file(cacheFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream out(&file);
+    out << CacheMagic << CacheVersion << qint32(cache.size());
+    for (auto it = cache.constBegin(); it != cache.constEnd(); ++it) {
+        out << it.key() << it->size << it->modified << it->histogram;
+    }
+    file.commit();
+}
@@ -0,0 +1,55 @@
+#ifndef HISTOGRAMLOADER_H
+#define HISTOGRAMLOADER_H
+
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+
+#include "HistogramStats.h"
+
+// Computes histograms for images whose thumbnail has not brought one yet,
+// so auto adjustments never decode on the GUI thread. Results are kept in
+// the folder cache next to the metadata index and perceptual hashes, so an
+// unchanged image is only analysed once.
+class HistogramLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HistogramLoader(QObject *parent = nullptr);
+    ~HistogramLoader();
+
+    // Queues a batch behind any running one; `ids` are passed back with
+    // each histogram. Every id gets a result, invalid if it failed.
+    void start(const QString &folderPath, const QStringList &paths, const QVector<int> &ids);
+    // Abandons every queued batch, e.g. when another folder is opened
+    void cancel();
+
+    int generation() const { return m_generation.load(); }
+
+signals:
+    // Queued to the GUI thread; drop results whose generation is stale
+    void histogramReady(int generation, int id, const HistogramStats &histogram);
+
+private:
+    struct CachedHistogram {
+        qint64         size;
+        qint64         modified;
+        HistogramStats histogram;
+    };
+    using HistogramCache = QHash<QString, CachedHistogram>;
+
+    void run(const QString &folderPath, const QStringList &paths, const QVector<int> &ids,
+             int generation);
+    static HistogramCache loadCache(const QString &cacheFile);
+    static void saveCache(const QString &cacheFile, const HistogramCache &cache);
+
+    std::atomic<int> m_generation { 0 };
+    QThreadPool      m_pool;
+};
+
+#endif // HISTOGRAMLOADER_H
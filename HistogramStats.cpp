@@ -0,0 +1,167 @@
+#include "HistogramStats.h"
+
+#include <QDataStream>
+#include <QImageReader>
+#include <QtMath>
+
+HistogramStats HistogramStats::compute(const QImage &image)
+{
+    HistogramStats stats;
+    if (image.isNull()) {
+        return stats;
+    }
+
+    switch (image.format()) {
+    case QImage::Format_RGBA64:
+    case QImage::Format_RGBX64:
+        stats.binRgba64(image);
+        break;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+    case QImage::Format_RGBA32FPx4:
+    case QImage::Format_RGBX32FPx4:
+        stats.binRgbaFloat(image);
+        break;
+#endif
+    default:
+        stats.binArgb32(image);
+        break;
+    }
+    return stats;
+}
+
+HistogramStats HistogramStats::computeForFile(const QString &path)
+{
+    QImageReader reader(path);
+    const QSize size = reader.size();
+    if (size.width() > AnalysisEdge || size.height() > AnalysisEdge) {
+        reader.setScaledSize(size.scaled(AnalysisEdge, AnalysisEdge, Qt::KeepAspectRatio));
+    }
+    return compute(reader.read());
+}
+
+int HistogramStats::maxCount() const
+{
+    int maxCount = 0;
+    for (int i = 0; i < 256; ++i) {
+        maxCount = qMax(maxCount, m_bins[Red][i]);
+        maxCount = qMax(maxCount, m_bins[Green][i]);
+        maxCount = qMax(maxCount, m_bins[Blue][i]);
+    }
+    return maxCount;
+}
+
+int HistogramStats::percentile(Channel channel, double fraction) const
+{
+    const double target = qBound(0.0, fraction, 1.0) * m_total;
+    const Bins &bins = m_bins[channel];
+
+    qint64 seen = 0;
+    for (int v = 0; v < 256; ++v) {
+        seen += bins[v];
+        if (seen > 0 && seen >= target) {
+            return v;
+        }
+    }
+    return 255;
+}
+
+double HistogramStats::trimmedMean(Channel channel, double low, double high) const
+{
+    // Bins straddling a cut contribute only the part inside it
+    const double from = qBound(0.0, low, 1.0) * m_total;
+    const double to   = qBound(0.0, high, 1.0) * m_total;
+    const Bins &bins = m_bins[channel];
+
+    double seen = 0.0;
+    double sum = 0.0;
+    double count = 0.0;
+    for (int v = 0; v < 256; ++v) {
+        const double inside = qMin(seen + bins[v], to) - qMax(seen, from);
+        if (inside > 0.0) {
+            sum += inside * v;
+            count += inside;
+        }
+        seen += bins[v];
+    }
+    return count > 0.0 ? sum / count : 127.5;
+}
+
+void HistogramStats::add(int r, int g, int b)
+{
+    ++m_bins[Red][r];
+    ++m_bins[Green][g];
+    ++m_bins[Blue][b];
+    // Rec. 601 weights in 8-bit fixed point
+    ++m_bins[Luma][(r * 77 + g * 150 + b * 29) >> 8];
+    ++m_total;
+}
+
+void HistogramStats::binArgb32(const QImage &image)
+{
+    QImage src = image;
+    if (src.format() != QImage::Format_ARGB32) {
+        src = src.convertToFormat(QImage::Format_ARGB32);
+    }
+
+    for (int y = 0; y < src.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(src.constScanLine(y));
+        for (int x = 0; x < src.width(); ++x) {
+            const QRgb pixel = line[x];
+            add(qRed(pixel), qGreen(pixel), qBlue(pixel));
+        }
+    }
+}
+
+void HistogramStats::binRgba64(const QImage &image)
+{
+    // Bin the 16-bit channels directly; the top byte selects the bin
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgba64 *line = reinterpret_cast<const QRgba64 *>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            const QRgba64 pixel = line[x];
+            add(pixel.red() >> 8, pixel.green() >> 8, pixel.blue() >> 8);
+        }
+    }
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+void HistogramStats::binRgbaFloat(const QImage &image)
+{
+    // Out-of-range (HDR) values land in the first/last bin
+    auto bin = [](float v) {
+        return qBound(0, int(v * 255.0f + 0.5f), 255);
+    };
+
+    for (int y = 0; y < image.height(); ++y) {
+        const float *line = reinterpret_cast<const float *>(image.constScanLine(y));
+        for (int x = 0; x < image.width() * 4; x += 4) {
+            add(bin(line[x + 0]), bin(line[x + 1]), bin(line[x + 2]));
+        }
+    }
+}
+#endif
+
+QDataStream &operator<<(QDataStream &out, const HistogramStats &stats)
+{
+    out << qint32(stats.m_total);
+    for (const HistogramStats::Bins &bins : stats.m_bins) {
+        for (int count : bins) {
+            out << qint32(count);
+        }
+    }
+    return out;
+}
+
+QDataStream &operator>>(QDataStream &in, HistogramStats &stats)
+{
+    qint32 value = 0;
+    in >> value;
+    stats.m_total = value;
+    for (HistogramStats::Bins &bins : stats.m_bins) {
+        for (int &count : bins) {
+            in >> value;
+            count = value;
+        }
+    }
+    return in;
+}
@@ -0,0 +1,62 @@
+#ifndef HISTOGRAMSTATS_H
+#define HISTOGRAMSTATS_H
+
+#include <QImage>
+#include <QMetaType>
+#include <QString>
+
+#include <array>
+
+class QDataStream;
+
+// 256-bin histograms of an image's red, green, blue and luma, in 8-bit
+// units whatever the source depth. Building one is a single pass over the
+// pixels; every query afterwards is O(256), so statistics can be kept per
+// image and asked again without touching pixels.
+class HistogramStats
+{
+public:
+    enum Channel { Red, Green, Blue, Luma, ChannelCount };
+    using Bins = std::array<int, 256>;
+
+    // Long edge of the reduced decode computeForFile() works from
+    static constexpr int AnalysisEdge = 256;
+
+    static HistogramStats compute(const QImage &image);
+
+    // Decodes the file at a small scale (JPEG scales while decoding)
+    static HistogramStats computeForFile(const QString &path);
+
+    bool isValid() const { return m_total > 0; }
+    int total() const { return m_total; }
+    const Bins &bins(Channel channel) const { return m_bins[channel]; }
+
+    // Highest count among the color channels, for drawing
+    int maxCount() const;
+
+    // Smallest value with at least `fraction` of the pixels at or below it
+    int percentile(Channel channel, double fraction) const;
+
+    // Mean of the pixels between two percentiles, so clipped highlights
+    // and shadows do not pull it
+    double trimmedMean(Channel channel, double low, double high) const;
+
+    // For the per-folder histogram cache
+    friend QDataStream &operator<<(QDataStream &out, const HistogramStats &stats);
+    friend QDataStream &operator>>(QDataStream &in, HistogramStats &stats);
+
+private:
+    void binArgb32(const QImage &image);
+    void binRgba64(const QImage &image);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+    void binRgbaFloat(const QImage &image);
+#endif
+    void add(int r, int g, int b);
+
+    std::array<Bins, ChannelCount> m_bins {};
+    int m_total = 0;
+};
+
+Q_DECLARE_METATYPE(HistogramStats)
+
+#endif // HISTOGRAMSTATS_H
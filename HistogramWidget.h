@@ -3,7 +3,8 @@
 
 #include <QWidget>
 #include <QImage>
-#include <QVector>
+
+#include "HistogramStats.h"
 
 class HistogramWidget : public QWidget
 {
@@ -13,19 +14,17 @@ public:
     explicit HistogramWidget(QWidget *parent = nullptr);
 
     void setImage(const QImage &image);
+    void setStats(const HistogramStats &stats);
     void clear();
 
+    const HistogramStats &stats() const { return m_stats; }
+
 protected:
     void paintEvent(QPaintEvent *event) override;
 
 private:
-    void rebuildHistogram(const QImage &image);
-
-    QVector<int> m_red;
-    QVector<int> m_green;
-    QVector<int> m_blue;
+    HistogramStats m_stats;
     int m_maxCount = 0;
-    bool m_hasImage = false;
 };
 
 #endif // HISTOGRAMWIDGET_H
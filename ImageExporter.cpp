@@ -0,0 +1,222 @@
+#include "ImageExporter.h"
+#include "ImageProcessor.h"
+#include "TileStreamer.h"
+
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QMutexLocker>
+
+ImageExporter::ImageExporter(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ImageExporter::~ImageExporter()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+QStringList ImageExporter::availableFormats()
+{
+    const QList<QByteArray> supported = QImageWriter::supportedImageFormats();
+
+    QStringList formats;
+    for (const char *format : {"jpg", "png", "webp"}) {
+        if (supported.contains(format)) {
+            formats << QString::fromLatin1(format);
+        }
+    }
+    formats << "ppm";
+    return formats;
+}
+
+void ImageExporter::start(const QVector<ExportRequest> &requests, int quality)
+{
+    if (isRunning()) {
+        return;
+    }
+
+    m_cancelled = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_progress = QVector<int>(requests.size(), 0);
+        m_errors.clear();
+        m_exported = 0;
+    }
+
+    if (requests.isEmpty()) {
+        emit finished(0, QStringList());
+        return;
+    }
+
+    m_remaining = requests.size();
+    emit progressChanged(0, requests.size() * ProgressSteps);
+
+    for (int i = 0; i < requests.size(); ++i) {
+        const ExportRequest request = requests[i];
+        m_pool.start([this, i, request, quality]() {
+            runRequest(i, request, quality);
+        });
+    }
+}
+
+void ImageExporter::setMemoryBudget(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_memoryBudget = qMax<qint64>(1, bytes);
+    m_memoryFreed.wakeAll();
+}
+
+void ImageExporter::cancel()
+{
+    m_cancelled = true;
+
+    // Jobs waiting for memory give up instead of decoding
+    QMutexLocker locker(&m_mutex);
+    m_memoryFreed.wakeAll();
+}
+
+qint64 ImageExporter::estimateBytes(const ExportRequest &request)
+{
+    QImageReader reader(request.sourcePath);
+    const QSize size = reader.size();
+    if (!size.isValid()) {
+        return 0;
+    }
+    const qint64 decoded = TileStreamer::decodedBytes(size, reader.imageFormat());
+
+    // Streamed output holds a strip and its processed copy, after a one-off
+    // whole decode for sources that cannot be read in parts
+    if (QFileInfo(request.targetPath).suffix().toLower() == "ppm") {
+        return TileStreamer::canStream(reader) ? TileStreamer::DefaultTileBudget
+                                               : 2 * decoded;
+    }
+
+    // The decoded source, its working-format copy and the render
+    return 3 * decoded;
+}
+
+bool ImageExporter::reserve(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_cancelled && m_memoryInUse > 0 && m_memoryInUse + bytes > m_memoryBudget) {
+        m_memoryFreed.wait(&m_mutex);
+    }
+    if (m_cancelled) {
+        return false;
+    }
+    m_memoryInUse += bytes;
+    // Under the lock, so the queued updates arrive in order
+    emit memoryInUseChanged(m_memoryInUse);
+    return true;
+}
+
+void ImageExporter::release(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_memoryInUse -= bytes;
+    emit memoryInUseChanged(m_memoryInUse);
+    m_memoryFreed.wakeAll();
+}
+
+void ImageExporter::runRequest(int index, const ExportRequest &request, int quality)
+{
+    const qint64 reserved = estimateBytes(request);
+    if (m_cancelled || !reserve(reserved)) {
+        completeRequest(false, QString());
+        return;
+    }
+
+    const QString suffix = QFileInfo(request.targetPath).suffix().toLower();
+    const QString fileName = QFileInfo(request.sourcePath).fileName();
+    QString error;
+    bool ok = false;
+
+    if (suffix == "ppm") {
+        // Streamed: never holds more than one strip of the image
+        ok = TileStreamer::process(
+            request.sourcePath,
+            request.targetPath,
+            request.properties,
+            TileStreamer::DefaultTileBudget,
+            [this, index](int rowsDone, int rowsTotal) {
+                reportProgress(index, int(qint64(rowsDone) * ProgressSteps / rowsTotal));
+                return !m_cancelled.load();
+            },
+            &error);
+    } else if (TileStreamer::needsStreaming(QImageReader(request.sourcePath))) {
+        if (TileStreamer::canStream(QImageReader(request.sourcePath))) {
+            error = tr("%1 is too large to encode as %2; export it as PPM instead.")
+                        .arg(fileName, suffix.toUpper());
+        } else {
+            error = tr("%1 is too large to export.").arg(fileName);
+        }
+    } else {
+        QImageReader reader(request.sourcePath);
+        reader.setAutoTransform(true);
+        QImage edited = ImageProcessor::applyAll(reader.read(), request.properties);
+        if (edited.isNull()) {
+            error = tr("Failed to load %1").arg(fileName);
+        } else {
+            reportProgress(index, ProgressSteps / 2);
+
+            // JPEG and WebP are 8-bit only; PNG keeps 16-bit data as is
+            if (suffix != "png" && edited.depth() > 32) {
+                edited = edited.convertToFormat(edited.hasAlphaChannel()
+                                                    ? QImage::Format_ARGB32
+                                                    : QImage::Format_RGB32);
+            }
+
+            QImageWriter writer(request.targetPath);
+            writer.setQuality(quality);
+            ok = writer.write(edited);
+            if (!ok) {
+                error = tr("Failed to write %1: %2")
+                            .arg(request.targetPath, writer.errorString());
+            }
+        }
+    }
+
+    release(reserved);
+    reportProgress(index, ProgressSteps);
+    completeRequest(ok, m_cancelled ? QString() : error);
+}
+
+void ImageExporter::reportProgress(int index, int steps)
+{
+    int value = 0;
+    int maximum = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_progress[index] = steps;
+        for (int p : m_progress) {
+            value += p;
+        }
+        maximum = m_progress.size() * ProgressSteps;
+    }
+
+    // Emitted from the worker; queued to receivers on the GUI thread
+    emit progressChanged(value, maximum);
+}
+
+void ImageExporter::completeRequest(bool ok, const QString &error)
+{
+    int exported = 0;
+    QStringList errors;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (ok) {
+            ++m_exported;
+        } else if (!error.isEmpty()) {
+            m_errors << error;
+        }
+        exported = m_exported;
+        errors = m_errors;
+    }
+
+    if (m_remaining.fetch_sub(1) == 1) {
+        emit finished(exported, errors);
+    }
+}
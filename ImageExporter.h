@@ -0,0 +1,80 @@
+#ifndef IMAGEEXPORTER_H
+#define IMAGEEXPORTER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <atomic>
+
+#include "ImageProperty.h"
+
+struct ExportRequest {
+    QString sourcePath;
+    QString targetPath;
+    PropertyTable properties;
+};
+
+// Renders edits at full resolution and encodes them on a background pool.
+// The full-size render only exists inside the worker for as long as the
+// encoder needs it; nothing is kept on the ImageItem. Each job reserves
+// an estimate of its working memory before decoding, and jobs wait while
+// the reservations would exceed the memory budget, so peak memory does
+// not grow with the number of cores.
+class ImageExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ImageExporter(QObject *parent = nullptr);
+    ~ImageExporter();
+
+    // Lower-case suffixes the encoder supports, e.g. "jpg", "png", "webp",
+    // plus "ppm", which is streamed strip by strip for very large sources
+    static QStringList availableFormats();
+
+    static constexpr qint64 DefaultMemoryBudget = qint64(1024) * 1024 * 1024;
+
+    // Working memory the running jobs may reserve together. A job larger
+    // than the whole budget still runs, but alone.
+    void setMemoryBudget(qint64 bytes);
+
+    void start(const QVector<ExportRequest> &requests, int quality);
+    void cancel();
+    bool isRunning() const { return m_remaining.load() > 0; }
+
+signals:
+    void progressChanged(int value, int maximum);
+    void finished(int exported, const QStringList &errors);
+    // Working memory reserved by the running jobs; emitted from workers
+    void memoryInUseChanged(qint64 bytes);
+
+private:
+    static constexpr int ProgressSteps = 1000;
+
+    static qint64 estimateBytes(const ExportRequest &request);
+
+    // Blocks until `bytes` fit in the budget; false if cancelled meanwhile
+    bool reserve(qint64 bytes);
+    void release(qint64 bytes);
+
+    void runRequest(int index, const ExportRequest &request, int quality);
+    void reportProgress(int index, int steps);
+    void completeRequest(bool ok, const QString &error);
+
+    QMutex           m_mutex;
+    QVector<int>     m_progress;
+    QStringList      m_errors;
+    int              m_exported = 0;
+    QWaitCondition   m_memoryFreed;
+    qint64           m_memoryBudget = DefaultMemoryBudget;
+    qint64           m_memoryInUse = 0;
+    std::atomic<int>  m_remaining { 0 };
+    std::atomic<bool> m_cancelled { false };
+    QThreadPool      m_pool;
+};
+
+#endif // IMAGEEXPORTER_H
@@ -1,96 +1,166 @@
 #include "ImageItem.h"
+#include "ImageProcessor.h"
+#include "TileStreamer.h"
 
-ImageItem::ImageItem(const QImage& originalImage)
+#include <QImageReader>
+#include <QThreadPool>
+
+#include <atomic>
+
+struct ImageItem::Pyramid {
+    QVector<QImage>   levels;
+    std::atomic<bool> ready { false };
+};
+
+namespace {
+
+// Halves down to 1x1. The whole chain costs about a third of scaling the
+// original once, so it is built in one go rather than level by level.
+QVector<QImage> buildLevels(const QImage& original)
 {
-    // Normalize format for later processing
-    if (originalImage.format() != QImage::Format_ARGB32) {
-        m_originalImage = originalImage.convertToFormat(QImage::Format_ARGB32);
-    } else {
-        m_originalImage = originalImage;
-    }
+    QVector<QImage> levels;
+    QImage previous = original;
+    while (previous.width() > 1 || previous.height() > 1) {
+        const QSize half(qMax(1, previous.width() / 2), qMax(1, previous.height() / 2));
 
-    m_editedImage = m_originalImage;
-    m_hasEdits    = false;
-
-    // Brightness: 0–100, 50 = neutral
-    m_properties.push_back(
-        ImageProperty(
-            PropertyId::Brightness,
-            "Brightness",
-            0,
-            100,
-            50
-            )
-        );
-
-    // Contrast: 0–100, 50 = neutral
-    m_properties.push_back(
-        ImageProperty(
-            PropertyId::Contrast,
-            "Contrast",
-            0,
-            100,
-            50
-            )
-        );
+        // Smooth scaling may hand back a premultiplied or opaque format
+        QImage reduced = previous.scaled(half, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        if (reduced.format() != original.format()) {
+            reduced = reduced.convertToFormat(original.format());
+        }
+        levels.push_back(reduced);
+        previous = reduced;
+    }
+    return levels;
 }
 
-void ImageItem::resetEdits()
+} // namespace
+
+ImageItem::ImageItem(const QString& sourcePath, const QSize& fullSize)
+    : m_sourcePath(sourcePath)
+    , m_fullSize(fullSize)
 {
-    m_editedImage = m_originalImage;
-    m_hasEdits    = false;
-    // You can optionally reset property values here if you want full reset
 }
 
-ImageProperty* ImageItem::findProperty(PropertyId id)
+bool ImageItem::load()
 {
-    for (auto &prop : m_properties) {
-        if (prop.id() == id)
-            return &prop;
+    if (isLoaded()) {
+        return true;
+    }
+
+    // Shown the way the camera was held (EXIF orientation)
+    QImageReader reader(m_sourcePath);
+    reader.setAutoTransform(true);
+    QSize fullSize = reader.size();
+    const bool streamed = TileStreamer::needsStreaming(reader);
+
+    QImage img = streamed ? TileStreamer::loadProxy(reader) : reader.read();
+    if (img.isNull()) {
+        return false;
+    }
+    if (reader.transformation() & QImageIOHandler::TransformationRotate90) {
+        fullSize.transpose();
     }
-    return nullptr;
+
+    setOriginalImage(img);
+    m_fullSize = streamed ? fullSize : img.size();
+    return true;
 }
 
-const ImageProperty* ImageItem::findProperty(PropertyId id) const
+bool ImageItem::unload()
 {
-    for (const auto &prop : m_properties) {
-        if (prop.id() == id)
-            return &prop;
+    if (m_sourcePath.isEmpty()) {
+        return false;
     }
-    return nullptr;
+
+    m_originalImage = QImage();
+    m_pyramid.reset();
+    return true;
 }
 
-int ImageItem::propertyValue(PropertyId id) const
+qint64 ImageItem::pyramidBytes() const
 {
-    const ImageProperty* prop = findProperty(id);
-    if (!prop)
-        return 0;
-    return prop->value();
+    qint64 bytes = 0;
+    if (isPyramidReady()) {
+        for (const QImage& level : m_pyramid->levels) {
+            bytes += level.sizeInBytes();
+        }
+    }
+    return bytes;
 }
 
-bool ImageItem::setPropertyValue(PropertyId id, int value)
+void ImageItem::setOriginalImage(const QImage& originalImage)
 {
-    ImageProperty* prop = findProperty(id);
-    if (!prop)
-        return false;
+    // Normalize format for later processing; 16-bit and float sources keep
+    // their precision instead of being squeezed into 8 bits per channel
+    const QImage::Format format = ImageProcessor::workingFormat(originalImage);
+    if (originalImage.format() != format) {
+        m_originalImage = originalImage.convertToFormat(format);
+    } else {
+        m_originalImage = originalImage;
+    }
 
-    prop->setValue(value);
-    return true;
+    m_pyramid.reset();
 }
 
-void ImageItem::setEditedImage(const QImage& img)
+const QImage& ImageItem::pyramidLevel(int level) const
 {
-    if (img.isNull()) {
-        m_editedImage = m_originalImage;
-        m_hasEdits    = false;
+    Q_ASSERT(level <= 0 || isPyramidReady());
+    if (level <= 0 || !isPyramidReady() || m_pyramid->levels.isEmpty()) {
+        return m_originalImage;
+    }
+    const QVector<QImage>& levels = m_pyramid->levels;
+    return levels[qMin(level, int(levels.size())) - 1];
+}
+
+void ImageItem::buildPyramid(const std::function<void()>& ready)
+{
+    if (m_pyramid || m_originalImage.isNull()) {
         return;
     }
 
-    if (img.format() != QImage::Format_ARGB32) {
-        m_editedImage = img.convertToFormat(QImage::Format_ARGB32);
-    } else {
-        m_editedImage = img;
+    // The worker keeps its own reference to the state, so unloading or
+    // releasing meanwhile just lets it finish into a state nobody reads
+    auto pyramid = std::make_shared<Pyramid>();
+    m_pyramid = pyramid;
+    const QImage original = m_originalImage;
+    QThreadPool::globalInstance()->start([pyramid, original, ready]() {
+        pyramid->levels = buildLevels(original);
+        pyramid->ready.store(true, std::memory_order_release);
+        if (ready) {
+            ready();
+        }
+    });
+}
+
+bool ImageItem::isPyramidReady() const
+{
+    return m_pyramid && m_pyramid->ready.load(std::memory_order_acquire);
+}
+
+int ImageItem::pyramidLevelFor(const QSize& target) const
+{
+    int level = 0;
+    QSize size = m_originalImage.size();
+    while (size.width() / 2 >= target.width() && size.height() / 2 >= target.height() &&
+           size.width() > 1 && size.height() > 1) {
+        size = QSize(size.width() / 2, size.height() / 2);
+        ++level;
     }
+    return level;
+}
+
+void ImageItem::setHistogram(const HistogramStats& histogram)
+{
+    m_histogram = histogram.isValid() ? std::make_shared<const HistogramStats>(histogram)
+                                      : nullptr;
+}
+
+bool ImageItem::setPropertyValue(PropertyId id, int value)
+{
+    if (id == PropertyId::Count)
+        return false;
 
-    m_hasEdits = true;
+    m_properties[id].setValue(value);
+    return true;
 }
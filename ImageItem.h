@@ -2,45 +2,93 @@
 #define IMAGEITEM_H
 
 #include <QImage>
+#include <QString>
 #include <QVector>
 
+#include <functional>
+#include <memory>
+
+#include "HistogramStats.h"
 #include "ImageProperty.h"
 
 class ImageItem
 {
 public:
-    // Construct from an already-loaded image (no filepath here)
-    explicit ImageItem(const QImage& originalImage);
+    // Construct from a file without decoding it; call load() before use.
+    // The size comes from the header and is replaced once loaded.
+    ImageItem(const QString& sourcePath, const QSize& fullSize);
+
+    bool isLoaded() const { return !m_originalImage.isNull(); }
+
+    // Decodes the source file if needed. Images too large to hold in memory
+    // are loaded as a reduced proxy.
+    bool load();
+
+    // Drops the decoded pixels of an item that has a source file; edits
+    // are kept and load() decodes it again
+    bool unload();
 
     const QImage& originalImage() const { return m_originalImage; }
 
-    // Edited image: if no edits yet, returns original
-    const QImage& editedImage() const {
-        return m_hasEdits ? m_editedImage : m_originalImage;
-    }
+    // Reduced copies of the original for previews. Level 0 is the original
+    // and every further level halves both sides, in the processor's working
+    // format. The levels are built once per decode, off the GUI thread, by
+    // buildPyramid(); until they are ready only level 0 is available.
+    const QImage& pyramidLevel(int level) const;
+
+    // Deepest level that is still at least `target` in both dimensions
+    int pyramidLevelFor(const QSize& target) const;
 
-    bool hasEdits() const { return m_hasEdits; }
+    // Starts building every level on the global thread pool, unless they
+    // are built or being built already. `ready` runs on the pool thread
+    // once they can be used.
+    void buildPyramid(const std::function<void()>& ready);
+    bool isPyramidReady() const;
 
-    void resetEdits();
+    // Frees the reduced levels; buildPyramid() makes them again
+    void releasePyramid() { m_pyramid.reset(); }
 
-    const QVector<ImageProperty>& properties() const { return m_properties; }
+    // Memory held by the decoded original, and by the levels
+    qint64 imageBytes() const { return m_originalImage.sizeInBytes(); }
+    qint64 pyramidBytes() const;
+
+    // Where the image came from and its full decoded size. Images too large
+    // to hold in memory keep only a reduced proxy as their original.
+    const QString& sourcePath() const { return m_sourcePath; }
+    QSize fullSize() const {
+        return m_fullSize.isValid() ? m_fullSize : m_originalImage.size();
+    }
+    bool isProxy() const {
+        return isLoaded() && fullSize() != m_originalImage.size();
+    }
+
+    const PropertyTable& properties() const { return m_properties; }
+
+    // Histogram of the unedited source, from a reduced decode. Null until
+    // known; kept when the pixels are unloaded since it is tiny.
+    const HistogramStats* histogram() const { return m_histogram.get(); }
+    void setHistogram(const HistogramStats& histogram);
 
     // Generic property access
-    int  propertyValue(PropertyId id) const;
     bool setPropertyValue(PropertyId id, int value);
 
-    // For the processor to push new image data
-    void setEditedImage(const QImage& img);
-
 private:
     QImage m_originalImage;
-    QImage m_editedImage;
-    bool   m_hasEdits = false;
 
-    QVector<ImageProperty> m_properties;
+    // Levels 1..n, written by the building thread before `ready` is set
+    // and never changed afterwards; shared by copies of the item
+    struct Pyramid;
+    std::shared_ptr<Pyramid> m_pyramid;
+
+    QString m_sourcePath;
+    QSize   m_fullSize;
+
+    PropertyTable m_properties;
+
+    // Shared so copying items in the list does not copy the bins
+    std::shared_ptr<const HistogramStats> m_histogram;
 
-    ImageProperty*       findProperty(PropertyId id);
-    const ImageProperty* findProperty(PropertyId id) const;
+    void setOriginalImage(const QImage& originalImage);
 };
 
 #endif // IMAGEITEM_H
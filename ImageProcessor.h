@@ -2,21 +2,68 @@
 #define IMAGEPROCESSOR_H
 
 #include <QImage>
-#include <QVector>
 
 #include "ImageProperty.h"
 
+class ColorLut;
+class FrameBufferPool;
+
 class ImageProcessor
 {
 public:
-    // Apply all properties to original image and return a new edited image
+    // Apply all properties to original image and return a new edited image,
+    // always in workingFormat(). When every property is neutral and the
+    // original is already in that format it is returned without a copy.
     static QImage applyAll(const QImage& original,
-                           const QVector<ImageProperty>& properties);
+                           const PropertyTable& properties);
+
+    // Same as above, but renders into `dst`, reusing its storage (or one
+    // from `pool`) so steady-state re-renders do not allocate. A neutral
+    // stack makes `dst` share the original (converted to the working
+    // format if needed) instead.
+    static void applyAll(const QImage& original,
+                         const PropertyTable& properties,
+                         QImage& dst,
+                         FrameBufferPool& pool);
+
+    // Renders only `rect` of src into dst with its top-left corner at `to`;
+    // dst must already have src's format and room for the area, src must
+    // be in working format. Used to refine an image tile by tile into a
+    // buffer that covers only part of it. With `display` the result is
+    // also converted for the screen in the same pass, and dst is tagged
+    // with the display color space.
+    static void applyRegion(const QImage& src,
+                            const PropertyTable& properties,
+                            QImage& dst,
+                            const QRect& rect,
+                            const QPoint& to,
+                            const ColorLut* display = nullptr);
+
+    // Converts `rect` of a working-format image into dst, which must be
+    // ARGB32_Premultiplied and rect's size, without allocating. Drawing
+    // from the result puts no format conversion in the paint path.
+    static void convertForDisplay(const QImage& src, const QRect& rect, QImage& dst);
+
+    // Slider to parameter mappings, in 8-bit units. Shared with code that
+    // solves for slider values, such as the auto adjustments.
+    static double brightnessOffset(int slider);
+    static double contrastFactor(int slider);
+    static void channelGains(int temperature, int tint, double gains[3]);
+
+    // Format the processor works in for a given image: RGBA64 for 16-bit
+    // sources, RGBA32FPx4 for floating point ones, ARGB32 for everything else.
+    static QImage::Format workingFormat(const QImage& image);
+    static QImage::Format workingFormat(QImage::Format format);
 
 private:
-    static bool tryGetProperty(const QVector<ImageProperty>& properties,
-                               PropertyId id,
-                               int& outValue);
+    // Runs the kernel for src's format over rect, writing it to dst at `to`;
+    // dst must already have src's format
+    static void render(const QImage& src,
+                       const PropertyTable& properties,
+                       QImage& dst,
+                       const QRect& rect,
+                       const QPoint& to,
+                       const ColorLut* display);
 };
 
 #endif // IMAGEPROCESSOR_H
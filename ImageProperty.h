@@ -3,11 +3,19 @@
 
 #include <QString>
 
+#include <array>
+
 enum class PropertyId {
     Brightness,
     Contrast,
+    Temperature,
+    Tint,
+
+    Count  // number of properties, not a property
 };
 
+constexpr int PropertyCount = int(PropertyId::Count);
+
 class ImageProperty {
 
 public:
@@ -21,6 +29,7 @@ public:
         , m_min(minValue)
         , m_max(maxValue)
         , m_value(initialValue)
+        , m_neutral(initialValue)
     {}
 
     PropertyId id() const         { return m_id; }
@@ -29,6 +38,8 @@ public:
     int min() const               { return m_min; }
     int max() const               { return m_max; }
     int value() const             { return m_value; }
+    int neutralValue() const      { return m_neutral; }
+    bool isNeutral() const        { return m_value == m_neutral; }
 
     void setValue(int value)
     {
@@ -42,7 +53,52 @@ private:
     QString    m_name;
     int        m_min;
     int        m_max;
-    int        m_value;  // current value (0–100 for both brightness & contrast)
+    int        m_value;  // current value (0–100 for every property so far)
+    int        m_neutral; // value at which the property leaves the image unchanged
+};
+
+// Fixed table of every property, indexed by PropertyId. Lookups are a
+// plain array access instead of a search by id.
+class PropertyTable {
+
+public:
+    PropertyTable()
+        : m_properties {{
+            // Brightness: 0–100, 50 = neutral
+            ImageProperty(PropertyId::Brightness, "Brightness", 0, 100, 50),
+            // Contrast: 0–100, 50 = neutral
+            ImageProperty(PropertyId::Contrast, "Contrast", 0, 100, 50),
+            // Temperature: 0–100, 50 = neutral; higher is warmer
+            ImageProperty(PropertyId::Temperature, "Temperature", 0, 100, 50),
+            // Tint: 0–100, 50 = neutral; higher is more magenta
+            ImageProperty(PropertyId::Tint, "Tint", 0, 100, 50),
+        }}
+    {
+        for (int i = 0; i < PropertyCount; ++i) {
+            Q_ASSERT(int(m_properties[size_t(i)].id()) == i);
+        }
+    }
+
+    const ImageProperty& operator[](PropertyId id) const { return m_properties[size_t(id)]; }
+    ImageProperty&       operator[](PropertyId id)       { return m_properties[size_t(id)]; }
+
+    int  value(PropertyId id) const     { return (*this)[id].value(); }
+    bool isNeutral(PropertyId id) const { return (*this)[id].isNeutral(); }
+
+    bool allNeutral() const
+    {
+        for (const ImageProperty &prop : m_properties) {
+            if (!prop.isNeutral())
+                return false;
+        }
+        return true;
+    }
+
+    auto begin() const { return m_properties.begin(); }
+    auto end() const   { return m_properties.end(); }
+
+private:
+    std::array<ImageProperty, PropertyCount> m_properties;
 };
 
 #endif // IMAGEPROPERTY_H
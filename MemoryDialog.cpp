@@ -0,0 +1,141 @@
+#include "MemoryDialog.h"
+#include "FrameBufferPool.h"
+#include "MemoryManager.h"
+
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QSpinBox>
+#include <QTableWidget>
+#include <QVBoxLayout>
+
+namespace {
+
+constexpr qint64 MiB = 1024 * 1024;
+
+QString megabytes(qint64 bytes)
+{
+    return QString::number(double(bytes) / MiB, 'f', 1);
+}
+
+QString costName(MemoryManager::Cost cost)
+{
+    switch (cost) {
+    case MemoryManager::Cost::Spare:   return QObject::tr("Spare");
+    case MemoryManager::Cost::Preview: return QObject::tr("Preview");
+    case MemoryManager::Cost::Render:  return QObject::tr("Render");
+    case MemoryManager::Cost::Decode:  return QObject::tr("Decode");
+    }
+    return QString();
+}
+
+} // namespace
+
+MemoryDialog::MemoryDialog(MemoryManager &memory, const FrameBufferPool &pool, QWidget *parent)
+    : QDialog(parent)
+    , m_memory(memory)
+    , m_pool(pool)
+{
+    setWindowTitle(tr("Memory Usage"));
+
+    m_table = new QTableWidget(0, 5, this);
+    m_table->setHorizontalHeaderLabels({ tr("Cache"), tr("Cost"), tr("Entries"),
+                                         tr("MB"), tr("Evictions") });
+    m_table->verticalHeader()->hide();
+    m_table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionMode(QAbstractItemView::NoSelection);
+
+    m_totalLabel  = new QLabel(this);
+    m_cgroupLabel = new QLabel(this);
+    m_poolLabel   = new QLabel(this);
+
+    // 0 leaves the choice to the manager
+    m_budgetSpin = new QSpinBox(this);
+    m_budgetSpin->setRange(0, 1024 * 1024);
+    m_budgetSpin->setSingleStep(256);
+    m_budgetSpin->setSuffix(tr(" MB"));
+    m_budgetSpin->setSpecialValueText(tr("Automatic"));
+    m_budgetSpin->setValue(int(m_memory.userBudget() / MiB));
+
+    auto *form = new QFormLayout;
+    form->addRow(tr("Budget"), m_budgetSpin);
+    form->addRow(tr("In use"), m_totalLabel);
+    form->addRow(tr("cgroup"), m_cgroupLabel);
+    form->addRow(tr("Frame pool"), m_poolLabel);
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::close);
+
+    auto *layout = new QVBoxLayout(this);
+    layout->addWidget(m_table, 1);
+    layout->addLayout(form);
+    layout->addWidget(buttons);
+
+    connect(m_budgetSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int value) {
+        m_memory.setUserBudget(qint64(value) * MiB);
+        refresh();
+    });
+
+    m_refreshTimer.setInterval(1000);
+    connect(&m_refreshTimer, &QTimer::timeout, this, &MemoryDialog::refresh);
+
+    resize(520, 360);
+}
+
+void MemoryDialog::showEvent(QShowEvent *event)
+{
+    QDialog::showEvent(event);
+    refresh();
+    m_refreshTimer.start();
+}
+
+void MemoryDialog::hideEvent(QHideEvent *event)
+{
+    m_refreshTimer.stop();
+    QDialog::hideEvent(event);
+}
+
+void MemoryDialog::refresh()
+{
+    const QVector<MemoryManager::CacheStats> stats = m_memory.stats();
+    m_table->setRowCount(stats.size());
+    for (int row = 0; row < stats.size(); ++row) {
+        const MemoryManager::CacheStats &cache = stats[row];
+        const QStringList cells {
+            cache.name,
+            costName(cache.cost),
+            QString::number(cache.entries),
+            megabytes(cache.bytes),
+            QString::number(cache.evictions),
+        };
+        for (int column = 0; column < cells.size(); ++column) {
+            QTableWidgetItem *item = m_table->item(row, column);
+            if (!item) {
+                item = new QTableWidgetItem;
+                if (column > 1) {
+                    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                }
+                m_table->setItem(row, column, item);
+            }
+            item->setText(cells[column]);
+        }
+    }
+
+    m_totalLabel->setText(tr("%1 of %2 MB")
+                              .arg(megabytes(m_memory.usage()), megabytes(m_memory.budget())));
+
+    if (m_memory.cgroupLimit() > 0) {
+        m_cgroupLabel->setText(tr("%1 of %2 MB used by the group")
+                                   .arg(megabytes(m_memory.cgroupUsage()),
+                                        megabytes(m_memory.cgroupLimit())));
+    } else {
+        m_cgroupLabel->setText(tr("No memory limit"));
+    }
+
+    m_poolLabel->setText(tr("%1 MB idle, %2 allocations, %3 reuses")
+                             .arg(megabytes(m_pool.idleBytes()))
+                             .arg(m_pool.allocations())
+                             .arg(m_pool.reuses()));
+}
@@ -0,0 +1,41 @@
+#ifndef MEMORYDIALOG_H
+#define MEMORYDIALOG_H
+
+#include <QDialog>
+#include <QTimer>
+
+class FrameBufferPool;
+class MemoryManager;
+class QLabel;
+class QSpinBox;
+class QTableWidget;
+
+// Debug view of the memory manager: what each cache holds, how often it
+// was evicted, the budget and the cgroup state. Refreshes while open.
+class MemoryDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    MemoryDialog(MemoryManager &memory, const FrameBufferPool &pool,
+                 QWidget *parent = nullptr);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    void refresh();
+
+    MemoryManager         &m_memory;
+    const FrameBufferPool &m_pool;
+
+    QTableWidget *m_table = nullptr;
+    QLabel       *m_totalLabel = nullptr;
+    QLabel       *m_cgroupLabel = nullptr;
+    QLabel       *m_poolLabel = nullptr;
+    QSpinBox     *m_budgetSpin = nullptr;
+    QTimer        m_refreshTimer;
+};
+
+#endif // MEMORYDIALOG_H
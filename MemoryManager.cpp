@@ -0,0 +1,198 @@
+#include "MemoryManager.h"
+
+#include <QFile>
+#include <QSettings>
+
+namespace {
+
+const char *BudgetKey = "memory/budget";
+
+constexpr int CgroupPollMs = 5000;
+
+// Share of the cgroup limit the group may use before the caches give way
+constexpr double CgroupPressure = 0.9;
+
+// A single number from a cgroup file; 0 for "max", absent files and the
+// near-2^63 values cgroup v1 uses for "no limit"
+qint64 readCgroupValue(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+
+    bool ok = false;
+    const qint64 value = file.readAll().trimmed().toLongLong(&ok);
+    if (!ok || value <= 0 || value >= (qint64(1) << 60)) {
+        return 0;
+    }
+    return value;
+}
+
+// Directory of this process's cgroup v2 memory controller
+QString cgroupDirectory()
+{
+    QFile file("/proc/self/cgroup");
+    if (file.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> lines = file.readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            if (line.startsWith("0::")) {
+                return QStringLiteral("/sys/fs/cgroup") + QString::fromUtf8(line.mid(3));
+            }
+        }
+    }
+    return QStringLiteral("/sys/fs/cgroup");
+}
+
+} // namespace
+
+MemoryManager::MemoryManager(QObject *parent)
+    : QObject(parent)
+{
+    m_userBudget = QSettings().value(BudgetKey, 0).toLongLong();
+
+    // Trimming waits for the event loop so an evictor never runs in the
+    // middle of the code that just reported an entry
+    m_trimTimer.setSingleShot(true);
+    m_trimTimer.setInterval(0);
+    connect(&m_trimTimer, &QTimer::timeout, this, [this] { trim(budget()); });
+
+    m_cgroupTimer.setInterval(CgroupPollMs);
+    connect(&m_cgroupTimer, &QTimer::timeout, this, &MemoryManager::pollCgroup);
+    m_cgroupTimer.start();
+    pollCgroup();
+}
+
+int MemoryManager::registerCache(const QString &name, Cost cost, const Evictor &evict)
+{
+    Cache cache;
+    cache.name  = name;
+    cache.cost  = cost;
+    cache.evict = evict;
+    m_caches.push_back(cache);
+    return m_caches.size() - 1;
+}
+
+void MemoryManager::touch(int cache, quint64 key, qint64 bytes)
+{
+    erase(cache, key);
+    if (bytes <= 0) {
+        return;
+    }
+
+    insert(cache, key, bytes);
+    if (m_usage > budget() && !m_trimTimer.isActive()) {
+        m_trimTimer.start();
+    }
+}
+
+void MemoryManager::remove(int cache, quint64 key)
+{
+    erase(cache, key);
+}
+
+void MemoryManager::removeAll(int cache)
+{
+    const QList<quint64> keys = m_caches[cache].entries.keys();
+    for (quint64 key : keys) {
+        erase(cache, key);
+    }
+}
+
+void MemoryManager::setUserBudget(qint64 bytes)
+{
+    m_userBudget = qMax<qint64>(0, bytes);
+    QSettings().setValue(BudgetKey, m_userBudget);
+    trim(budget());
+}
+
+qint64 MemoryManager::budget() const
+{
+    qint64 budget = m_userBudget > 0 ? m_userBudget : DefaultBudget;
+    if (m_cgroupLimit > 0) {
+        budget = qMin(budget, m_cgroupLimit / 2);
+    }
+    return budget;
+}
+
+QVector<MemoryManager::CacheStats> MemoryManager::stats() const
+{
+    QVector<CacheStats> result;
+    result.reserve(m_caches.size());
+    for (const Cache &cache : m_caches) {
+        result.push_back({ cache.name, cache.cost, int(cache.entries.size()),
+                           cache.bytes, cache.evictions });
+    }
+    return result;
+}
+
+void MemoryManager::trim(qint64 target)
+{
+    // Entries still in use are put back as if just used; stop once every
+    // entry has had its turn so a fully pinned set cannot loop forever
+    int attempts = int(m_order.size());
+    while (m_usage > target && !m_order.empty() && attempts-- > 0) {
+        const Slot victim = *m_order.begin();
+        const qint64 bytes = m_caches[victim.cache].entries.value(victim.key).bytes;
+        erase(victim.cache, victim.key);
+
+        // Copied: the evictor may register or report entries
+        const Evictor evict = m_caches[victim.cache].evict;
+        if (evict(victim.key)) {
+            m_clock = victim.priority;
+            ++m_caches[victim.cache].evictions;
+        } else {
+            insert(victim.cache, victim.key, bytes);
+        }
+    }
+}
+
+void MemoryManager::insert(int cache, quint64 key, qint64 bytes)
+{
+    Cache &c = m_caches[cache];
+    const Entry entry { bytes, m_clock + double(c.cost), ++m_sequence };
+    c.entries.insert(key, entry);
+    c.bytes += bytes;
+    m_usage += bytes;
+    m_order.insert({ entry.priority, entry.sequence, cache, key });
+}
+
+void MemoryManager::erase(int cache, quint64 key)
+{
+    Cache &c = m_caches[cache];
+    const auto it = c.entries.constFind(key);
+    if (it == c.entries.constEnd()) {
+        return;
+    }
+
+    m_order.erase({ it->priority, it->sequence, cache, key });
+    c.bytes -= it->bytes;
+    m_usage -= it->bytes;
+    c.entries.erase(it);
+}
+
+void MemoryManager::pollCgroup()
+{
+    // cgroup v2 first, then the v1 memory controller
+    const QString v2 = cgroupDirectory();
+    qint64 limit = readCgroupValue(v2 + "/memory.max");
+    qint64 used  = readCgroupValue(v2 + "/memory.current");
+    if (limit == 0) {
+        limit = readCgroupValue("/sys/fs/cgroup/memory/memory.limit_in_bytes");
+        used  = readCgroupValue("/sys/fs/cgroup/memory/memory.usage_in_bytes");
+    }
+
+    m_cgroupLimit = limit;
+    m_cgroupUsage = used;
+
+    // Other processes in the group, or memory we do not track, can push the
+    // group towards its limit; give back the difference from the caches
+    qint64 target = budget();
+    if (limit > 0) {
+        const qint64 excess = used - qint64(limit * CgroupPressure);
+        if (excess > 0) {
+            target = qMin(target, qMax<qint64>(0, m_usage - excess));
+        }
+    }
+    trim(target);
+}
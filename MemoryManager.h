@@ -0,0 +1,130 @@
+#ifndef MEMORYMANAGER_H
+#define MEMORYMANAGER_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+#include <functional>
+#include <set>
+
+// Accounts for the pixel memory held by every image cache in the viewer
+// and keeps the total under one budget. Caches register once, then report
+// each entry's size whenever it is filled or used. When the total is over
+// budget the manager evicts across all caches by cost-weighted LRU: an
+// entry's priority is the time it was last used plus what it costs to get
+// back, so cheap previews and thumbnails go long before a decoded original
+// that was used a little earlier.
+//
+// The budget is the user's setting, capped by the process's cgroup memory
+// limit when there is one, and the cgroup is watched so the caches shrink
+// when the container as a whole runs short. GUI thread only.
+class MemoryManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    // What an evicted entry costs to bring back, as an LRU weight
+    enum class Cost {
+        Spare   = 1,   // idle buffers: nothing to recompute
+        Preview = 2,   // thumbnails and reduced levels
+        Render  = 4,   // rendered edits
+        Decode  = 16,  // decoded originals
+    };
+
+    // Drops one entry and returns true, or returns false if it is in use
+    // right now. The manager has already forgotten the entry when this is
+    // called, so it may report other entries of the same or other caches.
+    using Evictor = std::function<bool(quint64 key)>;
+
+    struct CacheStats {
+        QString name;
+        Cost    cost;
+        int     entries;
+        qint64  bytes;
+        quint64 evictions;
+    };
+
+    static constexpr qint64 DefaultBudget = qint64(2048) * 1024 * 1024;
+
+    explicit MemoryManager(QObject *parent = nullptr);
+
+    int  registerCache(const QString &name, Cost cost, const Evictor &evict);
+
+    // Records that an entry holds `bytes` and was just used
+    void touch(int cache, quint64 key, qint64 bytes);
+    // The owner dropped an entry by itself
+    void remove(int cache, quint64 key);
+    void removeAll(int cache);
+
+    qint64 usage() const { return m_usage; }
+
+    // User budget in bytes, 0 meaning DefaultBudget; kept in the settings
+    qint64 userBudget() const { return m_userBudget; }
+    void setUserBudget(qint64 bytes);
+
+    // What is enforced: the user budget, capped at half the cgroup limit
+    // so decoders, Qt and the rest of the process keep some headroom
+    qint64 budget() const;
+
+    // cgroup limit and usage of the whole group, 0 when there is none
+    qint64 cgroupLimit() const { return m_cgroupLimit; }
+    qint64 cgroupUsage() const { return m_cgroupUsage; }
+
+    QVector<CacheStats> stats() const;
+
+    // Evicts until usage is at most `target`
+    void trim(qint64 target);
+
+private:
+    struct Entry {
+        qint64  bytes;
+        double  priority;
+        quint64 sequence;
+    };
+
+    struct Cache {
+        QString name;
+        Cost    cost;
+        Evictor evict;
+        QHash<quint64, Entry> entries;
+        qint64  bytes = 0;
+        quint64 evictions = 0;
+    };
+
+    // Eviction order: lowest priority first, least recently used on ties
+    struct Slot {
+        double  priority;
+        quint64 sequence;
+        int     cache;
+        quint64 key;
+
+        bool operator<(const Slot &other) const {
+            if (priority != other.priority) {
+                return priority < other.priority;
+            }
+            return sequence < other.sequence;
+        }
+    };
+
+    void insert(int cache, quint64 key, qint64 bytes);
+    void erase(int cache, quint64 key);
+    void pollCgroup();
+
+    QVector<Cache> m_caches;
+    std::set<Slot> m_order;
+    double  m_clock = 0.0;    // priority of the last victim
+    quint64 m_sequence = 0;
+    qint64  m_usage = 0;
+
+    qint64 m_userBudget = 0;
+    qint64 m_cgroupLimit = 0;
+    qint64 m_cgroupUsage = 0;
+
+    QTimer m_trimTimer;
+    QTimer m_cgroupTimer;
+};
+
+#endif // MEMORYMANAGER_H
@@ -0,0 +1,367 @@
+#include "MetadataIndex.h"
+#include "FolderCache.h"
+#include "ParallelFor.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QImageReader>
+#include <QSaveFile>
+
+#include <cstring>
+
+namespace {
+constexpr quint32 CacheMagic   = 0x4d455441; // "META"
+constexpr quint32 CacheVersion = 1;
+const char *const CacheName    = "metadata.dat";
+
+// Entries per reported batch: small enough to keep the GUI responsive
+// while they are listed, large enough that signals are not the cost
+constexpr int BatchSize = 512;
+
+// EXIF lives in APP1, which is limited to 64 KiB and sits near the start
+constexpr qint64 ExifScanBytes = 128 * 1024;
+
+// Bounds-checked reader for the TIFF structure inside an EXIF block
+class TiffReader
+{
+public:
+    TiffReader(const uchar *data, int size)
+        : m_data(data), m_size(size)
+    {
+        m_valid = size >= 8 &&
+                  ((data[0] == 'I' && data[1] == 'I') || (data[0] == 'M' && data[1] == 'M'));
+        m_littleEndian = m_valid && data[0] == 'I';
+        m_valid = m_valid && u16(2) == 42;
+    }
+
+    bool isValid() const { return m_valid; }
+    bool inRange(qint64 offset, qint64 length) const {
+        return offset >= 0 && length >= 0 && offset + length <= m_size;
+    }
+
+    quint16 u16(int offset) const {
+        if (!inRange(offset, 2)) return 0;
+        const uchar *p = m_data + offset;
+        return m_littleEndian ? quint16(p[0] | p[1] << 8)
+                              : quint16(p[0] << 8 | p[1]);
+    }
+
+    quint32 u32(int offset) const {
+        if (!inRange(offset, 4)) return 0;
+        const uchar *p = m_data + offset;
+        return m_littleEndian
+                   ? quint32(p[0]) | quint32(p[1]) << 8 | quint32(p[2]) << 16 | quint32(p[3]) << 24
+                   : quint32(p[0]) << 24 | quint32(p[1]) << 16 | quint32(p[2]) << 8 | quint32(p[3]);
+    }
+
+    // ASCII values of up to four bytes are stored inline in the entry
+    QString ascii(int entry) const {
+        const quint32 count = u32(entry + 4);
+        const qint64 offset = count <= 4 ? entry + 8 : qint64(u32(entry + 8));
+        if (count == 0 || !inRange(offset, count)) return QString();
+        const char *p = reinterpret_cast<const char *>(m_data + offset);
+        return QString::fromLatin1(p, int(qstrnlen(p, count))).trimmed();
+    }
+
+    // Calls fn(tag, entryOffset) for every entry of the IFD at `offset`
+    template <typename Fn>
+    void forEachEntry(quint32 offset, Fn fn) const {
+        const int count = u16(int(offset));
+        for (int i = 0; i < count; ++i) {
+            const qint64 entry = qint64(offset) + 2 + 12 * i;
+            if (!inRange(entry, 12)) return;
+            fn(u16(int(entry)), int(entry));
+        }
+    }
+
+private:
+    const uchar *m_data;
+    int  m_size;
+    bool m_valid = false;
+    bool m_littleEndian = false;
+};
+
+QDateTime parseExifTime(const QString &text)
+{
+    return QDateTime::fromString(text, "yyyy:MM:dd HH:mm:ss");
+}
+
+QDataStream &operator<<(QDataStream &out, const ImageMetadata &m)
+{
+    return out << m.fileName << m.fileSize << m.modified << m.size << m.format
+               << m.captureTime << m.camera << qint32(m.orientation);
+}
+
+QDataStream &operator>>(QDataStream &in, ImageMetadata &m)
+{
+    qint32 orientation = 1;
+    in >> m.fileName >> m.fileSize >> m.modified >> m.size >> m.format
+       >> m.captureTime >> m.camera >> orientation;
+    m.orientation = orientation;
+    return in;
+}
+
+QHash<QString, ImageMetadata> loadCache(const QString &cacheFile)
+{
+    QHash<QString, ImageMetadata> cache;
+
+    QFile file(cacheFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return cache;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 count = 0;
+    in >> magic >> version >> count;
+    if (magic != CacheMagic || version != CacheVersion || count < 0) {
+        return cache;
+    }
+
+    cache.reserve(count);
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        ImageMetadata metadata;
+        in >> metadata;
+        cache.insert(metadata.fileName, metadata);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        cache.clear();
+    }
+    return cache;
+}
+
+void saveCache(const QString &cacheFile, const QVector<ImageMetadata> &entries)
+{
+    QSaveFile file(cacheFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream out(&file);
+    out << CacheMagic << CacheVersion << qint32(entries.size());
+    for (const ImageMetadata &metadata : entries) {
+        out << metadata;
+    }
+    file.commit();
+}
+}
+
+void MetadataIndex::build(const QString &folderPath, const QFileInfoList &files,
+                          const Batch &batch, const std::function<bool()> &cancelled)
+{
+    const QString cacheFile = FolderCache::filePath(folderPath, CacheName);
+    const QHash<QString, ImageMetadata> cache = loadCache(cacheFile);
+
+    QVector<ImageMetadata> result(files.size());
+    QVector<int> pending;
+    QVector<ImageMetadata> known;
+
+    for (int i = 0; i < files.size(); ++i) {
+        const QFileInfo &info = files[i];
+        auto it = cache.constFind(info.fileName());
+        if (it != cache.constEnd() &&
+            it->fileSize == info.size() &&
+            it->modified == info.lastModified().toMSecsSinceEpoch()) {
+            result[i] = *it;
+            known.push_back(*it);
+            if (known.size() == BatchSize) {
+                batch(known);
+                known.clear();
+            }
+        } else {
+            pending.push_back(i);
+        }
+    }
+    if (!known.isEmpty()) {
+        batch(known);
+    }
+
+    // Header reads are small and mostly wait on the disk, so they overlap
+    // well; each chunk is reported as soon as it is read
+    ImageMetadata *out = result.data();
+    for (int first = 0; first < pending.size(); first += BatchSize) {
+        if (cancelled()) {
+            return;
+        }
+        const int count = qMin(BatchSize, int(pending.size()) - first);
+        parallelFor(count, [&](int k) {
+            const int i = pending[first + k];
+            out[i] = readHeader(files[i]);
+        });
+
+        QVector<ImageMetadata> chunk;
+        chunk.reserve(count);
+        for (int k = 0; k < count; ++k) {
+            chunk.push_back(out[pending[first + k]]);
+        }
+        batch(chunk);
+    }
+
+    if (!pending.isEmpty() || cache.size() != result.size()) {
+        saveCache(cacheFile, result);
+    }
+}
+
+bool MetadataIndex::lessThan(const ImageMetadata &a, const ImageMetadata &b,
+                             MetadataField field)
+{
+    auto byName = [&]() {
+        return a.fileName.compare(b.fileName, Qt::CaseInsensitive) < 0;
+    };
+
+    switch (field) {
+    case MetadataField::Name:
+        break;
+    case MetadataField::CaptureTime:
+        // Images without a capture time go last
+        if (a.captureTime.isValid() != b.captureTime.isValid())
+            return a.captureTime.isValid();
+        if (a.captureTime != b.captureTime)
+            return a.captureTime < b.captureTime;
+        break;
+    case MetadataField::Dimensions: {
+        const qint64 pixelsA = qint64(a.size.width()) * a.size.height();
+        const qint64 pixelsB = qint64(b.size.width()) * b.size.height();
+        if (pixelsA != pixelsB)
+            return pixelsA > pixelsB;
+        break;
+    }
+    case MetadataField::Format:
+        if (a.format != b.format)
+            return a.format < b.format;
+        break;
+    case MetadataField::Camera:
+        if (a.camera.isEmpty() != b.camera.isEmpty())
+            return !a.camera.isEmpty();
+        if (a.camera != b.camera)
+            return a.camera.compare(b.camera, Qt::CaseInsensitive) < 0;
+        break;
+    case MetadataField::Orientation:
+        if (a.orientation != b.orientation)
+            return a.orientation < b.orientation;
+        break;
+    }
+    return byName();
+}
+
+QStringList MetadataIndex::details(const ImageMetadata &metadata)
+{
+    const QSize size = metadata.orientedSize();
+    QStringList details;
+    details << QString("%1 x %2").arg(size.width()).arg(size.height())
+            << QString::fromLatin1(metadata.format).toUpper();
+    if (!metadata.camera.isEmpty()) {
+        details << metadata.camera;
+    }
+    if (metadata.captureTime.isValid()) {
+        details << metadata.captureTime.toString("yyyy-MM-dd HH:mm");
+    }
+    return details;
+}
+
+bool MetadataIndex::matches(const ImageMetadata &metadata, const QString &filter)
+{
+    if (filter.isEmpty()) {
+        return true;
+    }
+
+    if (metadata.fileName.contains(filter, Qt::CaseInsensitive)) {
+        return true;
+    }
+    for (const QString &detail : details(metadata)) {
+        if (detail.contains(filter, Qt::CaseInsensitive)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ImageMetadata MetadataIndex::readHeader(const QFileInfo &file)
+{
+    ImageMetadata metadata;
+    metadata.fileName = file.fileName();
+    metadata.fileSize = file.size();
+    metadata.modified = file.lastModified().toMSecsSinceEpoch();
+
+    // size() and format() only parse the header; no pixels are decoded
+    QImageReader reader(file.absoluteFilePath());
+    metadata.size   = reader.size();
+    metadata.format = reader.format();
+
+    if (metadata.format == "jpeg" || metadata.format == "jpg") {
+        readExif(file.absoluteFilePath(), metadata);
+    }
+    return metadata;
+}
+
+void MetadataIndex::readExif(const QString &path, ImageMetadata &metadata)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    const QByteArray head = file.read(ExifScanBytes);
+    const uchar *data = reinterpret_cast<const uchar *>(head.constData());
+    const int size = head.size();
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return;
+    }
+
+    // Walk the JPEG markers up to the first scan, looking for APP1 "Exif"
+    int pos = 2;
+    while (pos + 4 <= size && data[pos] == 0xFF) {
+        const uchar marker = data[pos + 1];
+        if (marker == 0xDA || marker == 0xD9) {
+            return;
+        }
+
+        const int length = data[pos + 2] << 8 | data[pos + 3];
+        if (marker == 0xE1 && length >= 8 && pos + 2 + length <= size &&
+            memcmp(data + pos + 4, "Exif\0\0", 6) == 0) {
+            const TiffReader tiff(data + pos + 10, length - 8);
+            if (!tiff.isValid()) {
+                return;
+            }
+
+            QString make;
+            QString model;
+            QString dateTime;
+            QString dateTimeOriginal;
+            quint32 exifIfd = 0;
+
+            tiff.forEachEntry(tiff.u32(4), [&](quint16 tag, int entry) {
+                switch (tag) {
+                case 0x010F: make = tiff.ascii(entry); break;
+                case 0x0110: model = tiff.ascii(entry); break;
+                case 0x0112: metadata.orientation = qBound(1, int(tiff.u16(entry + 8)), 8); break;
+                case 0x0132: dateTime = tiff.ascii(entry); break;
+                case 0x8769: exifIfd = tiff.u32(entry + 8); break;
+                default: break;
+                }
+            });
+
+            if (exifIfd != 0) {
+                tiff.forEachEntry(exifIfd, [&](quint16 tag, int entry) {
+                    if (tag == 0x9003) {
+                        dateTimeOriginal = tiff.ascii(entry);
+                    }
+                });
+            }
+
+            // Many makers repeat the brand in the model name
+            metadata.camera = model.startsWith(make, Qt::CaseInsensitive)
+                                  ? model
+                                  : QString("%1 %2").arg(make, model).trimmed();
+            metadata.captureTime = parseExifTime(dateTimeOriginal.isEmpty()
+                                                     ? dateTime
+                                                     : dateTimeOriginal);
+            return;
+        }
+
+        pos += 2 + length;
+    }
+}
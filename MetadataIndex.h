@@ -0,0 +1,68 @@
+#ifndef METADATAINDEX_H
+#define METADATAINDEX_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QMetaType>
+#include <QVector>
+
+#include <functional>
+
+struct ImageMetadata {
+    QString    fileName;
+    qint64     fileSize = 0;
+    qint64     modified = 0;     // msecs since epoch, used to validate the cache
+    QSize      size;
+    QByteArray format;
+    QDateTime  captureTime;      // EXIF DateTimeOriginal, else DateTime
+    QString    camera;           // EXIF Make + Model
+    int        orientation = 1;  // EXIF orientation, 1 = upright
+
+    // Size as displayed: orientations 5-8 turn the image on its side
+    QSize orientedSize() const { return orientation >= 5 ? size.transposed() : size; }
+};
+
+Q_DECLARE_METATYPE(ImageMetadata)
+
+enum class MetadataField {
+    Name,
+    CaptureTime,
+    Dimensions,
+    Format,
+    Camera,
+    Orientation,
+};
+
+// Per-folder index built from file headers only: QImageReader reports size
+// and format without decoding pixels, and the EXIF block is parsed from the
+// first bytes of the file. The index is persisted in the folder cache and
+// only files whose size or mtime changed are read again.
+class MetadataIndex
+{
+public:
+    using Batch = std::function<void(const QVector<ImageMetadata> &)>;
+
+    // Reports the entries in batches as they become known, cached ones
+    // first, so a caller can list them before every header has been read.
+    // Stops early when `cancelled` returns true; the cache is only saved
+    // once every file has been seen.
+    static void build(const QString &folderPath, const QFileInfoList &files,
+                      const Batch &batch, const std::function<bool()> &cancelled);
+
+    static bool lessThan(const ImageMetadata &a, const ImageMetadata &b,
+                         MetadataField field);
+    // Dimensions as displayed, format, camera and capture time, formatted
+    // for showing; the filter matches against the same text
+    static QStringList details(const ImageMetadata &metadata);
+    static bool matches(const ImageMetadata &metadata, const QString &filter);
+
+private:
+    static ImageMetadata readHeader(const QFileInfo &file);
+    static void readExif(const QString &path, ImageMetadata &metadata);
+};
+
+#endif // METADATAINDEX_H
@@ -0,0 +1,54 @@
+#include "MetadataLoader.h"
+
+#include <QDir>
+
+MetadataLoader::MetadataLoader(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<QVector<ImageMetadata>>();
+
+    // Single coordinator thread; header reads fan out to the global pool
+    m_pool.setMaxThreadCount(1);
+}
+
+MetadataLoader::~MetadataLoader()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void MetadataLoader::start(const QString &folderPath)
+{
+    const int generation = ++m_generation;
+
+    m_pool.start([this, folderPath, generation]() {
+        auto cancelled = [this, generation]() {
+            return m_generation.load() != generation;
+        };
+
+        // Listing a large folder stats every file, so it is done here too
+        const QStringList filters = {"*.jpg", "*.png", "*.gif", "*.bmp", "*.jpeg"};
+        const QFileInfoList files = QDir(folderPath).entryInfoList(filters, QDir::Files,
+                                                                   QDir::Name);
+        if (cancelled()) {
+            return;
+        }
+        emit folderListed(generation, int(files.size()));
+
+        MetadataIndex::build(
+            folderPath, files,
+            [this, generation](const QVector<ImageMetadata> &batch) {
+                emit metadataReady(generation, batch);
+            },
+            cancelled);
+
+        if (!cancelled()) {
+            emit finished(generation);
+        }
+    });
+}
+
+void MetadataLoader::cancel()
+{
+    ++m_generation;
+}
@@ -0,0 +1,42 @@
+#ifndef METADATALOADER_H
+#define METADATALOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+
+#include "MetadataIndex.h"
+
+// Lists a folder and builds its metadata index in the background, so a
+// folder of tens of thousands of files opens without blocking the GUI.
+// Entries arrive in batches and the list fills in as they do.
+class MetadataLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetadataLoader(QObject *parent = nullptr);
+    ~MetadataLoader();
+
+    // Starts on a new folder and abandons the previous one
+    void start(const QString &folderPath);
+    void cancel();
+
+    int generation() const { return m_generation.load(); }
+
+signals:
+    // All queued to the GUI thread; drop results whose generation is stale.
+    // `count` is the number of image files, before any header is read.
+    void folderListed(int generation, int count);
+    void metadataReady(int generation, const QVector<ImageMetadata> &batch);
+    void finished(int generation);
+
+private:
+    std::atomic<int> m_generation { 0 };
+    QThreadPool      m_pool;
+};
+
+#endif // METADATALOADER_H
@@ -0,0 +1,47 @@
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <atomic>
+
+// Runs fn(i) for every i in [0, count) on the global thread pool and returns
+// when all calls are done. Work is handed out one index at a time so slow
+// items (large files) do not stall a whole chunk. The calling thread takes
+// part in the loop, so this cannot deadlock on a saturated pool.
+template <typename Fn>
+void parallelFor(int count, Fn fn)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const int helpers = qMax(0, qMin(count, pool->maxThreadCount()) - 1);
+
+    std::atomic<int> next { 0 };
+    QSemaphore done;
+
+    auto worker = [&]() {
+        for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            fn(i);
+        }
+    };
+
+    int started = 0;
+    for (int h = 0; h < helpers; ++h) {
+        // A helper that is still queued when the work runs out finds
+        // nothing left and releases immediately
+        pool->start([&]() {
+            worker();
+            done.release();
+        });
+        ++started;
+    }
+
+    worker();
+    done.acquire(started);
+}
+
+#endif // PARALLELFOR_H
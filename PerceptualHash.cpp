@@ -0,0 +1,149 @@
+#include "PerceptualHash.h"
+#include "FolderCache.h"
+#include "HistogramStats.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QImageReader>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#include <bitset>
+
+namespace {
+constexpr int HashWidth  = 9;
+constexpr int HashHeight = 8;
+
+constexpr quint32 CacheMagic   = 0x50484153; // "PHAS"
+// 2: hashed from the thumbnail decode instead of a 64 px one
+constexpr quint32 CacheVersion = 2;
+const char *const CacheName    = "phash.dat";
+
+// Every folder's cache file goes through here, from several threads
+QMutex cacheMutex;
+
+PerceptualHashCache::Entries readCache(const QString &cacheFile)
+{
+    PerceptualHashCache::Entries cache;
+
+    QFile file(cacheFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return cache;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 count = 0;
+    in >> magic >> version >> count;
+    if (magic != CacheMagic || version != CacheVersion || count < 0) {
+        return cache;
+    }
+
+    cache.reserve(count);
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString name;
+        PerceptualHashCache::Entry entry;
+        in >> name >> entry.size >> entry.modified >> entry.hash;
+        cache.insert(name, entry);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        cache.clear();
+    }
+    return cache;
+}
+
+void writeCache(const QString &cacheFile, const PerceptualHashCache::Entries &cache)
+{
+    QSaveFile file(cacheFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream out(&file);
+    out << CacheMagic << CacheVersion << qint32(cache.size());
+    for (auto it = cache.constBegin(); it != cache.constEnd(); ++it) {
+        out << it.key() << it->size << it->modified << it->hash;
+    }
+    file.commit();
+}
+}
+
+quint64 PerceptualHash::compute(const QImage &image)
+{
+    if (image.isNull()) {
+        return 0;
+    }
+
+    const QImage small = image.scaled(HashWidth, HashHeight,
+                                      Qt::IgnoreAspectRatio,
+                                      Qt::SmoothTransformation)
+                             .convertToFormat(QImage::Format_Grayscale8);
+
+    quint64 hash = 0;
+    for (int y = 0; y < HashHeight; ++y) {
+        const uchar *line = small.constScanLine(y);
+        for (int x = 0; x < HashWidth - 1; ++x) {
+            hash = (hash << 1) | (line[x] < line[x + 1] ? 1 : 0);
+        }
+    }
+    return hash;
+}
+
+bool PerceptualHash::computeForFile(const QString &path, quint64 &outHash)
+{
+    QImageReader reader(path);
+    reader.setAutoTransform(true);
+    const QSize size = reader.size();
+    if (size.width() > HistogramStats::AnalysisEdge ||
+        size.height() > HistogramStats::AnalysisEdge) {
+        reader.setScaledSize(size.scaled(HistogramStats::AnalysisEdge,
+                                         HistogramStats::AnalysisEdge,
+                                         Qt::KeepAspectRatio));
+    }
+
+    const QImage image = reader.read();
+    if (image.isNull()) {
+        return false;
+    }
+
+    outHash = compute(image);
+    return true;
+}
+
+int PerceptualHash::distance(quint64 a, quint64 b)
+{
+    return int(std::bitset<64>(a ^ b).count());
+}
+
+PerceptualHashCache::Entries PerceptualHashCache::load(const QString &folderPath)
+{
+    QMutexLocker locker(&cacheMutex);
+    return readCache(FolderCache::filePath(folderPath, CacheName));
+}
+
+void PerceptualHashCache::merge(const QString &folderPath, const Entries &entries)
+{
+    if (entries.isEmpty()) {
+        return;
+    }
+
+    QMutexLocker locker(&cacheMutex);
+    const QString cacheFile = FolderCache::filePath(folderPath, CacheName);
+    Entries cache = readCache(cacheFile);
+
+    bool changed = false;
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        auto existing = cache.constFind(it.key());
+        if (existing == cache.constEnd() || existing->size != it->size ||
+            existing->modified != it->modified || existing->hash != it->hash) {
+            cache.insert(it.key(), *it);
+            changed = true;
+        }
+    }
+    if (changed) {
+        writeCache(cacheFile, cache);
+    }
+}
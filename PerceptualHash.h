@@ -0,0 +1,45 @@
+#ifndef PERCEPTUALHASH_H
+#define PERCEPTUALHASH_H
+
+#include <QHash>
+#include <QImage>
+#include <QString>
+
+// 64-bit difference hash (dHash): each bit says whether a pixel of a 9x8
+// grayscale reduction is brighter than its right neighbour. Resizes,
+// recompression and small exposure changes flip only a few bits, so the
+// Hamming distance between two hashes measures how alike the images look.
+class PerceptualHash
+{
+public:
+    // From any reduced decode; the thumbnail loader hashes the image it
+    // decodes for the thumbnail
+    static quint64 compute(const QImage &image);
+
+    // Decodes the file the way the thumbnail loader does (upright, long
+    // edge at HistogramStats::AnalysisEdge), so both give the same hash
+    static bool computeForFile(const QString &path, quint64 &outHash);
+
+    static int distance(quint64 a, quint64 b);
+};
+
+// A folder's hashes, persisted in the folder cache and keyed by file name,
+// valid while the file's size and mtime match. The thumbnail loader and
+// the duplicate finder both add to it; merges are serialized and re-read
+// the file, so neither loses the other's entries.
+class PerceptualHashCache
+{
+public:
+    struct Entry {
+        qint64  size;
+        qint64  modified;
+        quint64 hash;
+    };
+    using Entries = QHash<QString, Entry>;
+
+    static Entries load(const QString &folderPath);
+    // Adds or replaces `entries`, writing only if something changed
+    static void merge(const QString &folderPath, const Entries &entries);
+};
+
+#endif // PERCEPTUALHASH_H
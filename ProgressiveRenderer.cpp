@@ -0,0 +1,358 @@
+#include "ProgressiveRenderer.h"
+#include "ColorLut.h"
+#include "FrameBufferPool.h"
+#include "ImageItem.h"
+#include "ImageProcessor.h"
+#include "MemoryManager.h"
+
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QtMath>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+ProgressiveRenderer::ProgressiveRenderer(FrameBufferPool &pool, MemoryManager &memory,
+                                         QObject *parent)
+    : QObject(parent)
+    , m_pool(pool)
+    , m_memory(memory)
+{
+    m_memoryCache = m_memory.registerCache(tr("Rendered tiles"), MemoryManager::Cost::Render,
+                                           [this](quint64 level) { return evictLevel(int(level)); });
+
+    m_timer.setInterval(0);
+    connect(&m_timer, &QTimer::timeout, this, &ProgressiveRenderer::step);
+}
+
+ProgressiveRenderer::~ProgressiveRenderer()
+{
+    // The pool and memory manager may not outlive us, so leave them alone
+    m_timer.stop();
+}
+
+void ProgressiveRenderer::render(ImageItem *item, const QSize &viewSize, const QRectF &visible)
+{
+    m_timer.stop();
+    m_pass = Pass::Idle;
+
+    if (!item || !item->isLoaded() || !item->isPyramidReady() ||
+        viewSize.isEmpty() || visible.isEmpty()) {
+        cancel();
+        return;
+    }
+
+    // Cached tiles survive pans and zooms, but not new edits or a new image
+    if (item != m_item) {
+        releaseTiles();
+        m_item = item;
+        m_properties = item->properties();
+    } else if (!std::equal(m_properties.begin(), m_properties.end(),
+                           item->properties().begin(),
+                           [](const ImageProperty &a, const ImageProperty &b) {
+                               return a.value() == b.value();
+                           })) {
+        m_properties = item->properties();
+        invalidateTiles();
+    }
+
+    // Compiled once per profile pair and shared
+    const std::shared_ptr<const ColorLut> lut =
+        ColorLut::get(item->originalImage().colorSpace(), m_displaySpace);
+    if (lut != m_displayLut) {
+        m_displayLut = lut;
+        invalidateTiles();
+    }
+    m_visible = visible;
+
+    // Screen pixels per original pixel, and the pyramid levels that match
+    // the view and a quarter of it
+    const QSize original = item->originalImage().size();
+    const double scale = qMin(viewSize.width() / visible.width(),
+                              viewSize.height() / visible.height());
+    const QSize needed(qMax(1, qCeil(original.width() * scale)),
+                       qMax(1, qCeil(original.height() * scale)));
+    const int overviewLevel = item->pyramidLevelFor(QSize(qMax(1, viewSize.width() / 4),
+                                                          qMax(1, viewSize.height() / 4)));
+    m_level = qMin(item->pyramidLevelFor(needed), overviewLevel);
+
+    // The level matching the view, not the original: the viewer converts
+    // what it is given for display, so keep that to about the view's size
+    if (m_properties.allNeutral() && !m_displayLut) {
+        emit frameReady(item->pyramidLevel(m_level), mapToLevel(visible, m_level));
+        emit overviewReady(item->pyramidLevel(overviewLevel));
+        emit finished();
+        return;
+    }
+
+    // Pass 1: the overview is small enough to render in well under a frame.
+    // Its cache entry is created first so the finer level cannot move it.
+    LevelCache &overview = levelCache(overviewLevel, item->pyramidLevel(overviewLevel).rect());
+    for (int i = 0; i < overview.valid.size(); ++i) {
+        if (!overview.valid[i]) {
+            renderTile(overviewLevel, i);
+        }
+    }
+    emit overviewReady(overview.image);
+
+    if (m_level == overviewLevel) {
+        emit frameReady(overview.image, mapToLevel(visible, overviewLevel));
+        emit finished();
+        return;
+    }
+
+    // Pass 2: the visible region plus one tile of margin for panning. Tiles
+    // not rendered yet start out as the scaled-up overview.
+    const QSize levelSize = item->pyramidLevel(m_level).size();
+    const QRectF area = mapToLevel(visible, m_level);
+    const QRect region = area.toAlignedRect().adjusted(-TileSize, -TileSize, TileSize, TileSize)
+                       & QRect(QPoint(0, 0), levelSize);
+    LevelCache &cache = levelCache(m_level, region);
+
+    m_tiles = tilesIn(cache, region);
+    m_tiles.erase(std::remove_if(m_tiles.begin(), m_tiles.end(),
+                                 [&cache](int i) { return cache.valid[i]; }),
+                  m_tiles.end());
+    sortFromCentre(m_tiles, cache, area.center());
+    m_nextTile = 0;
+
+    if (!m_tiles.isEmpty()) {
+        const QSizeF ratio(qreal(overview.image.width()) / levelSize.width(),
+                           qreal(overview.image.height()) / levelSize.height());
+        QPainter painter(&cache.image);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+        for (int index : std::as_const(m_tiles)) {
+            const QRect tile = tileRect(cache, index);
+            const QRectF from(tile.x() * ratio.width(), tile.y() * ratio.height(),
+                              tile.width() * ratio.width(), tile.height() * ratio.height());
+            painter.drawImage(QRectF(tile.translated(-cache.bounds.topLeft())),
+                              overview.image, from);
+        }
+    }
+
+    emit frameReady(cache.image, area.translated(-QPointF(cache.bounds.topLeft())));
+
+    m_pass = Pass::Visible;
+    m_timer.start();
+}
+
+void ProgressiveRenderer::setDisplayColorSpace(const QColorSpace &space)
+{
+    m_displaySpace = space.isValid() ? space : QColorSpace(QColorSpace::SRgb);
+}
+
+void ProgressiveRenderer::cancel()
+{
+    m_timer.stop();
+    m_pass = Pass::Idle;
+    m_tiles.clear();
+    m_nextTile = 0;
+    releaseTiles();
+    m_item = nullptr;
+}
+
+ProgressiveRenderer::LevelCache &ProgressiveRenderer::levelCache(int level, const QRect &needed)
+{
+    if (m_levels.size() <= level) {
+        m_levels.resize(level + 1);
+    }
+
+    LevelCache &cache = m_levels[level];
+    const QImage &source = m_item->pyramidLevel(level);
+    const QRect area = needed & source.rect();
+    const QRect aligned = alignToTiles(area.isEmpty() ? source.rect() : area, source.rect());
+    if (cache.image.isNull() || cache.image.format() != source.format() ||
+        !cache.bounds.contains(aligned)) {
+        // Leave room to pan a little before the window has to move again
+        const QRect grown = aligned.adjusted(-aligned.width() / 4, -aligned.height() / 4,
+                                             aligned.width() / 4, aligned.height() / 4);
+        moveWindow(cache, alignToTiles(grown & source.rect(), source.rect()), source.format());
+    }
+    m_memory.touch(m_memoryCache, quint64(level), cache.image.sizeInBytes());
+    return cache;
+}
+
+void ProgressiveRenderer::moveWindow(LevelCache &cache, const QRect &bounds,
+                                     QImage::Format format)
+{
+    LevelCache moved;
+    moved.bounds = bounds;
+    moved.columns = (bounds.width() + TileSize - 1) / TileSize;
+    const int rows = (bounds.height() + TileSize - 1) / TileSize;
+    moved.valid.fill(false, moved.columns * rows);
+    m_pool.prepare(moved.image, bounds.size(), format);
+
+    // Both windows sit on the same tile grid, so rendered tiles the new one
+    // still covers are copied over whole
+    if (cache.image.format() == format) {
+        const int bytesPerPixel = cache.image.depth() / 8;
+        for (int i = 0; i < cache.valid.size(); ++i) {
+            const QRect tile = tileRect(cache, i);
+            if (!cache.valid[i] || !bounds.contains(tile)) {
+                continue;
+            }
+            const QPoint from = tile.topLeft() - cache.bounds.topLeft();
+            const QPoint to = tile.topLeft() - bounds.topLeft();
+            const size_t rowBytes = size_t(tile.width()) * bytesPerPixel;
+            for (int y = 0; y < tile.height(); ++y) {
+                memcpy(moved.image.scanLine(to.y() + y) + to.x() * bytesPerPixel,
+                       cache.image.constScanLine(from.y() + y) + from.x() * bytesPerPixel,
+                       rowBytes);
+            }
+            moved.valid[(to.y() / TileSize) * moved.columns + to.x() / TileSize] = true;
+        }
+        moved.image.setColorSpace(cache.image.colorSpace());
+    }
+
+    m_pool.recycle(cache.image);
+    cache = std::move(moved);
+}
+
+void ProgressiveRenderer::renderTile(int level, int index)
+{
+    LevelCache &cache = m_levels[level];
+    const QRect tile = tileRect(cache, index);
+    ImageProcessor::applyRegion(m_item->pyramidLevel(level), m_properties, cache.image,
+                                tile, tile.topLeft() - cache.bounds.topLeft(),
+                                m_displayLut.get());
+    cache.valid[index] = true;
+}
+
+void ProgressiveRenderer::invalidateTiles()
+{
+    // Buffers are kept: the next render overwrites them in place
+    for (LevelCache &cache : m_levels) {
+        cache.valid.fill(false);
+    }
+}
+
+void ProgressiveRenderer::releaseTiles()
+{
+    for (LevelCache &cache : m_levels) {
+        m_pool.recycle(cache.image);
+    }
+    m_levels.clear();
+    m_memory.removeAll(m_memoryCache);
+}
+
+bool ProgressiveRenderer::evictLevel(int level)
+{
+    // The level being refined is in use; anything else is rendered again
+    // when it is next needed
+    if (m_pass != Pass::Idle && level == m_level) {
+        return false;
+    }
+    if (level >= m_levels.size()) {
+        return true;
+    }
+
+    LevelCache &cache = m_levels[level];
+    cache.image = QImage();
+    cache.bounds = QRect();
+    cache.valid.clear();
+    cache.columns = 0;
+    return true;
+}
+
+QRectF ProgressiveRenderer::mapToLevel(const QRectF &rect, int level) const
+{
+    // Levels halve with integer rounding, so scale by the real size ratio
+    const QSize original = m_item->originalImage().size();
+    const QSize size = m_item->pyramidLevel(level).size();
+    const qreal sx = qreal(size.width()) / original.width();
+    const qreal sy = qreal(size.height()) / original.height();
+    return QRectF(rect.x() * sx, rect.y() * sy, rect.width() * sx, rect.height() * sy);
+}
+
+QRect ProgressiveRenderer::alignToTiles(const QRect &rect, const QRect &level) const
+{
+    // Out to whole tiles of the level's grid, clipped to the level
+    const QPoint topLeft((rect.left() / TileSize) * TileSize, (rect.top() / TileSize) * TileSize);
+    const QPoint bottomRight((rect.right() / TileSize + 1) * TileSize - 1,
+                             (rect.bottom() / TileSize + 1) * TileSize - 1);
+    return QRect(topLeft, bottomRight) & level;
+}
+
+QRect ProgressiveRenderer::tileRect(const LevelCache &cache, int index) const
+{
+    // In level coordinates; the window's edges are the level's or the grid's
+    const QRect tile(cache.bounds.x() + (index % cache.columns) * TileSize,
+                     cache.bounds.y() + (index / cache.columns) * TileSize,
+                     TileSize, TileSize);
+    return tile & cache.bounds;
+}
+
+QVector<int> ProgressiveRenderer::tilesIn(const LevelCache &cache, const QRect &area) const
+{
+    QVector<int> tiles;
+    const QRect clipped = (area & cache.bounds).translated(-cache.bounds.topLeft());
+    if (clipped.isEmpty()) {
+        return tiles;
+    }
+
+    for (int row = clipped.top() / TileSize; row <= clipped.bottom() / TileSize; ++row) {
+        for (int column = clipped.left() / TileSize; column <= clipped.right() / TileSize; ++column) {
+            tiles.push_back(row * cache.columns + column);
+        }
+    }
+    return tiles;
+}
+
+void ProgressiveRenderer::sortFromCentre(QVector<int> &tiles, const LevelCache &cache,
+                                         const QPointF &centre) const
+{
+    // Centre first: that is where the eye is
+    const QPoint c = centre.toPoint();
+    std::sort(tiles.begin(), tiles.end(), [this, &cache, &c](int a, int b) {
+        return (tileRect(cache, a).center() - c).manhattanLength() <
+               (tileRect(cache, b).center() - c).manhattanLength();
+    });
+}
+
+void ProgressiveRenderer::step()
+{
+    if (m_pass == Pass::Idle || !m_item) {
+        m_timer.stop();
+        return;
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+    while (m_nextTile < m_tiles.size() && clock.elapsed() < SliceMs) {
+        renderTile(m_level, m_tiles[m_nextTile++]);
+    }
+
+    LevelCache &cache = m_levels[m_level];
+    if (m_pass == Pass::Visible) {
+        emit frameReady(cache.image, mapToLevel(m_visible, m_level)
+                                         .translated(-QPointF(cache.bounds.topLeft())));
+    }
+
+    if (m_nextTile < m_tiles.size()) {
+        return;
+    }
+
+    if (m_pass == Pass::Visible) {
+        emit finished();
+
+        // Pass 3: whatever is left of the window, nearest to the view first,
+        // one slice per event loop turn so input stays responsive
+        m_tiles.clear();
+        for (int i = 0; i < cache.valid.size(); ++i) {
+            if (!cache.valid[i]) {
+                m_tiles.push_back(i);
+            }
+        }
+        sortFromCentre(m_tiles, cache, mapToLevel(m_visible, m_level).center());
+        m_nextTile = 0;
+        m_pass = Pass::Background;
+        if (!m_tiles.isEmpty()) {
+            return;
+        }
+    }
+
+    m_timer.stop();
+    m_pass = Pass::Idle;
+}
@@ -0,0 +1,120 @@
+#ifndef PROGRESSIVERENDERER_H
+#define PROGRESSIVERENDERER_H
+
+#include <QColorSpace>
+#include <QImage>
+#include <QObject>
+#include <QRect>
+#include <QTimer>
+#include <QVector>
+
+#include <memory>
+
+#include "ImageProperty.h"
+
+class ColorLut;
+class FrameBufferPool;
+class ImageItem;
+class MemoryManager;
+
+// Renders edits for the part of the image that is on screen, in passes of
+// increasing quality so the view never waits for the whole frame:
+//   1. an overview level of the whole frame, rendered at once; it is shown
+//      immediately and feeds the histogram,
+//   2. the visible region (plus a margin for panning) at the level matching
+//      the zoom, refined tile by tile,
+//   3. the remaining off-screen tiles of a window around the view at that
+//      level, filled in lazily so a short pan finds them ready.
+// Rendered tiles are cached per pyramid level until the edits change, so
+// panning and zooming only render what has not been seen yet; levels the
+// memory manager evicts are rendered again when next needed. Finer levels
+// only keep the window around the view, never a whole zoomed-in image;
+// the window moves with the view, keeping the tiles it still covers. Tiles run
+// in short slices on the GUI thread; a new render() call drops whatever is
+// left of the previous one, so stale parameters never finish.
+//
+// Results are converted from the image's embedded profile to the display
+// color space in the same pass as the edits.
+class ProgressiveRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+    ProgressiveRenderer(FrameBufferPool &pool, MemoryManager &memory,
+                        QObject *parent = nullptr);
+    ~ProgressiveRenderer() override;
+
+    // `visible` is the part of the item shown in a view of `viewSize`, in
+    // coordinates of the item's original image. The item's pyramid must be
+    // ready (ImageItem::isPyramidReady()).
+    void render(ImageItem *item, const QSize &viewSize, const QRectF &visible);
+
+    // Stops rendering and drops the tile cache
+    void cancel();
+
+    // Where rendered frames are shown; sRGB unless a monitor profile is set.
+    // Takes effect with the next render().
+    void setDisplayColorSpace(const QColorSpace &space);
+    const QColorSpace &displayColorSpace() const { return m_displaySpace; }
+    bool isRunning() const { return m_pass != Pass::Idle; }
+
+signals:
+    // Best result so far: `sourceRect` of `image` is the visible region,
+    // which may be smaller than the view and is scaled up. `image` may
+    // cover only the area around it.
+    void frameReady(const QImage &image, const QRectF &sourceRect);
+    // The whole frame at a reduced size, for statistics such as histograms
+    void overviewReady(const QImage &overview);
+    // Everything visible is at full quality
+    void finished();
+
+private:
+    enum class Pass { Idle, Visible, Background };
+
+    static constexpr int TileSize = 256;
+    static constexpr int SliceMs  = 8;
+
+    // One pyramid level's rendered pixels inside `bounds`, a tile-aligned
+    // window of the level, and which tiles of it are current
+    struct LevelCache {
+        QImage         image;   // covers bounds
+        QRect          bounds;  // in level coordinates
+        QVector<bool>  valid;   // row-major, one per tile of the window
+        int            columns = 0;
+    };
+
+    void step();
+    LevelCache &levelCache(int level, const QRect &needed);
+    void moveWindow(LevelCache &cache, const QRect &bounds, QImage::Format format);
+    void renderTile(int level, int index);
+    void invalidateTiles();
+    void releaseTiles();
+    bool evictLevel(int level);
+
+    QRectF mapToLevel(const QRectF &rect, int level) const;
+    QRect alignToTiles(const QRect &rect, const QRect &level) const;
+    QRect tileRect(const LevelCache &cache, int index) const;
+    QVector<int> tilesIn(const LevelCache &cache, const QRect &area) const;
+    void sortFromCentre(QVector<int> &tiles, const LevelCache &cache, const QPointF &centre) const;
+
+    FrameBufferPool &m_pool;
+    MemoryManager   &m_memory;
+    int              m_memoryCache = -1;
+    ImageItem       *m_item = nullptr;
+    PropertyTable    m_properties;
+
+    QColorSpace                     m_displaySpace { QColorSpace::SRgb };
+    std::shared_ptr<const ColorLut> m_displayLut;  // null: no conversion
+
+    QVector<LevelCache> m_levels;
+
+    Pass   m_pass = Pass::Idle;
+    int    m_level = 0;         // level being refined
+    QRectF m_visible;           // in original image coordinates
+
+    QVector<int> m_tiles;       // tile indices still to render this pass
+    int          m_nextTile = 0;
+    QTimer       m_timer;
+};
+
+#endif // PROGRESSIVERENDERER_H
@@ -0,0 +1,81 @@
+#include "ThumbnailLoader.h"
+#include "ParallelFor.h"
+#include "PerceptualHash.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QMutex>
+#include <QMutexLocker>
+
+ThumbnailLoader::ThumbnailLoader(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<HistogramStats>();
+
+    // Single coordinator thread; decoding fans out to the global pool
+    m_pool.setMaxThreadCount(1);
+}
+
+ThumbnailLoader::~ThumbnailLoader()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void ThumbnailLoader::start(const QString &folderPath, const QStringList &paths,
+                            const QVector<int> &ids)
+{
+    const int generation = ++m_generation;
+
+    m_pool.start([this, folderPath, paths, ids, generation]() {
+        QMutex hashesMutex;
+        PerceptualHashCache::Entries hashes;
+
+        parallelFor(int(paths.size()), [&](int i) {
+            if (m_generation.load() != generation) {
+                return;
+            }
+
+            // Decoding costs about the same at either size (JPEG reduces by
+            // up to 1/8 while decoding), so decode once for the histogram
+            // and shrink that for the thumbnail
+            QImageReader reader(paths[i]);
+            reader.setAutoTransform(true);
+            const QSize size = reader.size();
+            if (size.width() > HistogramStats::AnalysisEdge ||
+                size.height() > HistogramStats::AnalysisEdge) {
+                reader.setScaledSize(size.scaled(HistogramStats::AnalysisEdge,
+                                                 HistogramStats::AnalysisEdge,
+                                                 Qt::KeepAspectRatio));
+            }
+
+            const QImage decoded = reader.read();
+            if (decoded.isNull()) {
+                return;
+            }
+
+            const HistogramStats histogram = HistogramStats::compute(decoded);
+            const QImage thumbnail = decoded.scaled(ThumbnailEdge, ThumbnailEdge,
+                                                    Qt::KeepAspectRatio,
+                                                    Qt::SmoothTransformation);
+            emit thumbnailReady(generation, ids[i], thumbnail, histogram);
+
+            const QFileInfo info(paths[i]);
+            const PerceptualHashCache::Entry entry {
+                info.size(), info.lastModified().toMSecsSinceEpoch(),
+                PerceptualHash::compute(decoded)
+            };
+            QMutexLocker locker(&hashesMutex);
+            hashes.insert(info.fileName(), entry);
+        });
+
+        // Also when abandoned: what was decoded is hashed already
+        PerceptualHashCache::merge(folderPath, hashes);
+    });
+}
+
+void ThumbnailLoader::cancel()
+{
+    ++m_generation;
+}
@@ -0,0 +1,47 @@
+#ifndef THUMBNAILLOADER_H
+#define THUMBNAILLOADER_H
+
+#include <QImage>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+
+#include "HistogramStats.h"
+
+// Decodes list thumbnails in the background so a folder can be listed from
+// its metadata index straight away. Thumbnails are decoded at reduced size
+// (JPEG scales while decoding) rather than from a full-size image. The same
+// decode yields the image's histogram, which is kept for auto adjustments,
+// and its perceptual hash, which goes to the folder's hash cache for the
+// duplicate finder.
+class ThumbnailLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int ThumbnailEdge = 56;
+
+    explicit ThumbnailLoader(QObject *parent = nullptr);
+    ~ThumbnailLoader();
+
+    // Starts a new batch of files in `folderPath` and abandons the previous
+    // one; `ids` are passed back with each thumbnail
+    void start(const QString &folderPath, const QStringList &paths, const QVector<int> &ids);
+    void cancel();
+
+    int generation() const { return m_generation.load(); }
+
+signals:
+    // Queued to the GUI thread; drop results whose generation is stale
+    void thumbnailReady(int generation, int id, const QImage &thumbnail,
+                        const HistogramStats &histogram);
+
+private:
+    std::atomic<int> m_generation { 0 };
+    QThreadPool      m_pool;
+};
+
+#endif // THUMBNAILLOADER_H
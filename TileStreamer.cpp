@@ -0,0 +1,418 @@
+#include "TileStreamer.h"
+#include "FrameBufferPool.h"
+#include "ImageProcessor.h"
+
+#include <QFile>
+#include <QImageReader>
+#include <QPixelFormat>
+#include <QTemporaryFile>
+
+#include <memory>
+
+#ifdef IMAGEVIEWER_HAVE_LIBJPEG
+#include <csetjmp>
+#include <cstdio>
+extern "C" {
+#include <jpeglib.h>
+}
+#endif
+
+namespace {
+
+#ifdef IMAGEVIEWER_HAVE_LIBJPEG
+struct JpegError {
+    jpeg_error_mgr base;
+    jmp_buf        jump;
+    char           message[JMSG_LENGTH_MAX];
+};
+
+// libjpeg's default handler exits the process
+void jpegErrorExit(j_common_ptr info)
+{
+    JpegError* error = reinterpret_cast<JpegError*>(info->err);
+    (*info->err->format_message)(info, error->message);
+    longjmp(error->jump, 1);
+}
+
+// One libjpeg decompressor kept open over a memory-mapped file, handing out
+// scanlines top to bottom. QImageReader's clip rectangle would restart the
+// decode from the top of the file for every strip. The setjmp frames hold
+// no objects with destructors, which is what makes the longjmp safe.
+class JpegScanlines
+{
+public:
+    ~JpegScanlines()
+    {
+        if (m_created) {
+            jpeg_destroy_decompress(&m_info);
+        }
+    }
+
+    bool open(const QString& path, bool mirror, QString* error)
+    {
+        m_mirror = mirror;
+        m_file.setFileName(path);
+        if (!m_file.open(QIODevice::ReadOnly)) {
+            *error = m_file.errorString();
+            return false;
+        }
+        uchar* data = m_file.map(0, m_file.size());
+        if (!data) {
+            *error = m_file.errorString();
+            return false;
+        }
+
+        m_info.err = jpeg_std_error(&m_error.base);
+        m_error.base.error_exit = jpegErrorExit;
+        if (setjmp(m_error.jump)) {
+            *error = QString::fromLatin1(m_error.message);
+            return false;
+        }
+        jpeg_create_decompress(&m_info);
+        m_created = true;
+        jpeg_mem_src(&m_info, data, static_cast<unsigned long>(m_file.size()));
+        jpeg_read_header(&m_info, TRUE);
+
+        // libjpeg cannot turn these into RGB
+        if (m_info.jpeg_color_space == JCS_CMYK || m_info.jpeg_color_space == JCS_YCCK) {
+            *error = QString("CMYK JPEG files cannot be read row by row");
+            return false;
+        }
+        m_info.out_color_space = JCS_RGB;
+        jpeg_start_decompress(&m_info);
+        m_row.resize(int(m_info.output_width) * 3);
+        return true;
+    }
+
+    // The next strip.height() rows, into an ARGB32 strip
+    bool read(QImage& strip, QString* error)
+    {
+        JSAMPROW row = reinterpret_cast<JSAMPROW>(m_row.data());
+        if (setjmp(m_error.jump)) {
+            *error = QString::fromLatin1(m_error.message);
+            return false;
+        }
+        for (int y = 0; y < strip.height(); ++y) {
+            if (jpeg_read_scanlines(&m_info, &row, 1) != 1) {
+                *error = QString("The file ends early");
+                return false;
+            }
+            const uchar* in = reinterpret_cast<const uchar*>(m_row.constData());
+            QRgb* out = reinterpret_cast<QRgb*>(strip.scanLine(y));
+            const int last = strip.width() - 1;
+            for (int x = 0; x <= last; ++x) {
+                out[m_mirror ? last - x : x] = qRgb(in[x * 3], in[x * 3 + 1], in[x * 3 + 2]);
+            }
+        }
+        return true;
+    }
+
+private:
+    QFile                  m_file;
+    jpeg_decompress_struct m_info {};
+    JpegError              m_error {};
+    bool                   m_created = false;
+    bool                   m_mirror = false;
+    QByteArray             m_row;
+};
+#endif
+
+// Full-width strips of the source, in working format, read top to bottom.
+// JPEG is decoded row by row as the strips are asked for. Anything else
+// is decoded whole once, which the caller only allows below the in-memory
+// limit, and its rows spilled to a raw file that strips are read back
+// from, so the decoded image does not stay around while strips are
+// processed and written.
+class StripSource
+{
+public:
+    bool open(const QString& path, bool sequential, bool mirror, bool fitsInMemory,
+              QString* error)
+    {
+#ifdef IMAGEVIEWER_HAVE_LIBJPEG
+        if (sequential) {
+            m_jpeg.reset(new JpegScanlines);
+            if (m_jpeg->open(path, mirror, error)) {
+                return true;
+            }
+            m_jpeg.reset();
+            if (!fitsInMemory) {
+                return false;
+            }
+        }
+#else
+        Q_UNUSED(sequential);
+        Q_UNUSED(mirror);
+        Q_UNUSED(fitsInMemory);
+#endif
+
+        QImageReader reader(path);
+        reader.setAutoTransform(true);
+        QImage image = reader.read();
+        if (image.isNull()) {
+            *error = QString("Failed to decode %1: %2").arg(path, reader.errorString());
+            return false;
+        }
+        m_format = ImageProcessor::workingFormat(image);
+        image.convertTo(m_format);
+        m_rowBytes = qint64(image.width()) * image.depth() / 8;
+
+        if (!m_cache.open()) {
+            *error = QString("Cannot create a cache file: %1").arg(m_cache.errorString());
+            return false;
+        }
+        for (int y = 0; y < image.height(); ++y) {
+            if (m_cache.write(reinterpret_cast<const char*>(image.constScanLine(y)),
+                              m_rowBytes) != m_rowBytes) {
+                *error = QString("Cannot write the cache file: %1").arg(m_cache.errorString());
+                return false;
+            }
+        }
+        return m_cache.seek(0);
+    }
+
+    // Strips must be asked for in order, each starting where the last ended
+    bool read(const QRect& clip, QImage& strip, FrameBufferPool& pool, QString* error)
+    {
+#ifdef IMAGEVIEWER_HAVE_LIBJPEG
+        if (m_jpeg) {
+            pool.prepare(strip, clip.size(), QImage::Format_ARGB32);
+            return m_jpeg->read(strip, error);
+        }
+#endif
+
+        pool.prepare(strip, clip.size(), m_format);
+        for (int y = 0; y < clip.height(); ++y) {
+            if (m_cache.read(reinterpret_cast<char*>(strip.scanLine(y)), m_rowBytes) != m_rowBytes) {
+                *error = m_cache.errorString();
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+#ifdef IMAGEVIEWER_HAVE_LIBJPEG
+    std::unique_ptr<JpegScanlines> m_jpeg;
+#endif
+    QTemporaryFile m_cache;
+    QImage::Format m_format = QImage::Format_Invalid;
+    qint64         m_rowBytes = 0;
+};
+
+} // namespace
+
+qint64 TileStreamer::inMemoryLimit()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    // 0 means the reader has no limit
+    const int megabytes = QImageReader::allocationLimit();
+    if (megabytes > 0) {
+        return qMin(MaxInMemoryBytes, qint64(megabytes) * 1024 * 1024);
+    }
+#endif
+    return MaxInMemoryBytes;
+}
+
+qint64 TileStreamer::decodedBytes(const QSize& size, QImage::Format format)
+{
+    const QImage::Format working = ImageProcessor::workingFormat(format);
+    const qint64 bytesPerPixel = QImage::toPixelFormat(working).bitsPerPixel() / 8;
+    return qint64(size.width()) * size.height() * bytesPerPixel;
+}
+
+bool TileStreamer::canStream(const QImageReader& reader)
+{
+#ifdef IMAGEVIEWER_HAVE_LIBJPEG
+    // Rows read top to bottom can only be mirrored
+    const QImageIOHandler::Transformations transform = reader.transformation();
+    return reader.format() == "jpeg" &&
+           !(transform & (QImageIOHandler::TransformationFlip |
+                          QImageIOHandler::TransformationRotate90));
+#else
+    Q_UNUSED(reader);
+    return false;
+#endif
+}
+
+bool TileStreamer::needsStreaming(const QImageReader& reader)
+{
+    const QSize size = reader.size();
+    if (!size.isValid()) {
+        return false;
+    }
+    return decodedBytes(size, reader.imageFormat()) > inMemoryLimit();
+}
+
+QImage TileStreamer::loadProxy(QImageReader& reader)
+{
+    const QSize size = reader.size();
+    reader.setScaledSize(size.scaled(ProxyEdge, ProxyEdge, Qt::KeepAspectRatio));
+    return reader.read();
+}
+
+bool TileStreamer::process(const QString& sourcePath,
+                           const QString& targetPath,
+                           const PropertyTable& properties,
+                           qint64 tileBudgetBytes,
+                           const Progress& progress,
+                           QString* errorMessage)
+{
+    auto fail = [errorMessage](const QString& message) {
+        if (errorMessage) {
+            *errorMessage = message;
+        }
+        return false;
+    };
+
+    QImageReader probe(sourcePath);
+    QSize size = probe.size();
+    if (!size.isValid()) {
+        return fail(QString("Cannot read image header: %1").arg(probe.errorString()));
+    }
+
+    // Written the way the camera was held, like the other export formats
+    const QImageIOHandler::Transformations transform = probe.transformation();
+    if (transform & QImageIOHandler::TransformationRotate90) {
+        size.transpose();
+    }
+
+    // Anything that cannot be read row by row has to be decoded whole
+    // once, which is only possible below the in-memory limit
+    const bool sequential = canStream(probe);
+    const bool fitsInMemory = !needsStreaming(probe);
+    if (!sequential && !fitsInMemory) {
+        if (probe.format() == "jpeg") {
+            return fail(QString("This image is stored turned or flipped, which cannot be "
+                                "read in parts, and it is too large to process whole."));
+        }
+        return fail(QString("%1 files cannot be read in parts, so this one "
+                            "is too large to process.")
+                        .arg(QString::fromLatin1(probe.format()).toUpper()));
+    }
+
+    // Source strip + processed strip per row
+    const qint64 rowBytes = decodedBytes(QSize(size.width(), 1), probe.imageFormat());
+    const int stripRows = int(qBound<qint64>(1, tileBudgetBytes / (2 * rowBytes), size.height()));
+
+    QFile out(targetPath);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return fail(QString("Cannot write %1: %2").arg(targetPath, out.errorString()));
+    }
+
+    QString error;
+    StripSource source;
+    const bool mirror = transform & QImageIOHandler::TransformationMirror;
+    if (!source.open(sourcePath, sequential, mirror, fitsInMemory, &error)) {
+        out.remove();
+        return fail(error);
+    }
+
+    FrameBufferPool pool(2);
+    QImage strip;
+    QImage processed;
+    QByteArray row;
+    QImage::Format outputFormat = QImage::Format_Invalid;
+
+    for (int y = 0; y < size.height(); y += stripRows) {
+        const QRect clip(0, y, size.width(), qMin(stripRows, size.height() - y));
+
+        if (!source.read(clip, strip, pool, &error)) {
+            out.remove();
+            return fail(QString("Failed to decode rows %1-%2: %3")
+                            .arg(clip.top())
+                            .arg(clip.bottom())
+                            .arg(error));
+        }
+
+        // Every adjustment is per-pixel, so strips need no overlap
+        ImageProcessor::applyAll(strip, properties, processed, pool);
+
+        // Binary PPM is written top to bottom, which is what lets the output
+        // grow strip by strip; the first strip decides the sample depth.
+        // applyAll always returns the working format, so the row writer
+        // only meets the formats it knows.
+        if (outputFormat == QImage::Format_Invalid) {
+            outputFormat = processed.format();
+            out.write(QString("P6\n%1 %2\n%3\n")
+                          .arg(size.width())
+                          .arg(size.height())
+                          .arg(outputFormat == QImage::Format_ARGB32 ? 255 : 65535)
+                          .toLatin1());
+        } else if (processed.format() != outputFormat) {
+            processed = processed.convertToFormat(outputFormat);
+        }
+
+        writePpmRows(processed, row, outputFormat != QImage::Format_ARGB32, out);
+
+        // A neutral stack shares the strip; let go so its buffer is reused
+        if (processed.cacheKey() == strip.cacheKey()) {
+            processed = QImage();
+        }
+        if (out.error() != QFileDevice::NoError) {
+            const QString message = out.errorString();
+            out.remove();
+            return fail(QString("Cannot write %1: %2").arg(targetPath, message));
+        }
+
+        if (progress && !progress(clip.bottom() + 1, size.height())) {
+            out.remove();
+            return fail(QString("Cancelled"));
+        }
+    }
+
+    out.close();
+    return true;
+}
+
+void TileStreamer::writePpmRows(const QImage& strip, QByteArray& row,
+                                bool sixteenBit, QIODevice& out)
+{
+    const int w = strip.width();
+    row.resize(w * (sixteenBit ? 6 : 3));
+    uchar* dst = reinterpret_cast<uchar*>(row.data());
+
+    // PPM has no alpha channel and stores 16-bit samples big-endian
+    auto put16 = [&dst](int offset, quint16 v) {
+        dst[offset]     = uchar(v >> 8);
+        dst[offset + 1] = uchar(v & 0xff);
+    };
+
+    for (int y = 0; y < strip.height(); ++y) {
+        switch (strip.format()) {
+        case QImage::Format_RGBA64: {
+            const QRgba64* line = reinterpret_cast<const QRgba64*>(strip.constScanLine(y));
+            for (int x = 0; x < w; ++x) {
+                put16(x * 6 + 0, line[x].red());
+                put16(x * 6 + 2, line[x].green());
+                put16(x * 6 + 4, line[x].blue());
+            }
+            break;
+        }
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+        case QImage::Format_RGBA32FPx4: {
+            const float* line = reinterpret_cast<const float*>(strip.constScanLine(y));
+            auto to16 = [](float v) {
+                return quint16(qBound(0.0f, v, 1.0f) * 65535.0f + 0.5f);
+            };
+            for (int x = 0; x < w; ++x) {
+                put16(x * 6 + 0, to16(line[x * 4 + 0]));
+                put16(x * 6 + 2, to16(line[x * 4 + 1]));
+                put16(x * 6 + 4, to16(line[x * 4 + 2]));
+            }
+            break;
+        }
+#endif
+        default: {
+            const QRgb* line = reinterpret_cast<const QRgb*>(strip.constScanLine(y));
+            for (int x = 0; x < w; ++x) {
+                dst[x * 3 + 0] = uchar(qRed(line[x]));
+                dst[x * 3 + 1] = uchar(qGreen(line[x]));
+                dst[x * 3 + 2] = uchar(qBlue(line[x]));
+            }
+            break;
+        }
+        }
+        out.write(row);
+    }
+}
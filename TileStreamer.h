@@ -0,0 +1,62 @@
+#ifndef TILESTREAMER_H
+#define TILESTREAMER_H
+
+#include <QImage>
+#include <QString>
+
+#include <functional>
+
+#include "ImageProperty.h"
+
+class QIODevice;
+class QImageReader;
+
+// Processes images that are too large to hold in memory. JPEG sources are
+// decoded top to bottom by one libjpeg decompressor, in horizontal strips;
+// every strip runs through ImageProcessor, and the result is appended to a
+// binary PPM file as it is produced, so peak memory is bounded by the strip
+// budget rather than by the image size. Other formats have no row-by-row
+// decoder here: they are decoded whole once into a raw strip cache on disk,
+// which only works below the in-memory limit, so they cannot be streamed.
+// Without libjpeg at build time nothing streams. The EXIF orientation is
+// applied as for the other export formats; row-by-row decoding can only
+// mirror, so flipped or turned JPEG files take the whole-image path too.
+class TileStreamer
+{
+public:
+    // Upper bound for holding a decoded image in memory
+    static constexpr qint64 MaxInMemoryBytes = 512ll * 1024 * 1024;
+    // Memory allowed for one decoded strip plus its processed copy
+    static constexpr qint64 DefaultTileBudget = 64ll * 1024 * 1024;
+    // Longest edge of the proxy shown for streamed images
+    static constexpr int ProxyEdge = 4096;
+
+    // Returns false from the callback to cancel
+    using Progress = std::function<bool(int rowsDone, int rowsTotal)>;
+
+    // Decoded images above this size are only opened as a reduced proxy.
+    // Never above QImageReader's allocation limit, where a plain read fails.
+    static qint64 inMemoryLimit();
+
+    static qint64 decodedBytes(const QSize& size, QImage::Format format);
+    static bool needsStreaming(const QImageReader& reader);
+    // Whether process() can read the source in parts, i.e. handle files
+    // above the in-memory limit: upright or mirrored JPEG
+    static bool canStream(const QImageReader& reader);
+
+    // Decode a reduced copy, letting the decoder scale where it can
+    static QImage loadProxy(QImageReader& reader);
+
+    static bool process(const QString& sourcePath,
+                        const QString& targetPath,
+                        const PropertyTable& properties,
+                        qint64 tileBudgetBytes = DefaultTileBudget,
+                        const Progress& progress = Progress(),
+                        QString* errorMessage = nullptr);
+
+private:
+    static void writePpmRows(const QImage& strip, QByteArray& row,
+                             bool sixteenBit, QIODevice& out);
+};
+
+#endif // TILESTREAMER_H
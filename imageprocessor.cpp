@@ -1,81 +1,438 @@
 #include "ImageProcessor.h"
+#include "ColorLut.h"
+#include "FrameBufferPool.h"
+#include <QColorSpace>
+#include <QPainter>
 #include <QtMath>
 
-bool ImageProcessor::tryGetProperty(const QVector<ImageProperty>& properties,
-                                    PropertyId id,
-                                    int& outValue)
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Parameters shared by all kernels, in 8-bit units
+struct Adjustments {
+    double brightnessOffset;  // added after contrast
+    double contrastFactor;    // scales around mid-grey
+    double gain[3];           // white balance, per channel, applied first
+    const ColorLut *display;  // applied last, when converting for display
+};
+
+// Tone curve for one channel value, `unit` being the size of one 8-bit
+// step in the target format. Disabled operations compile away entirely.
+template <bool Brightness, bool Contrast, bool Balance>
+inline double toneCurve(double v, double gain, const Adjustments& adj, double unit)
 {
-    for (const auto& prop : properties) {
-        if (prop.id() == id) {
-            outValue = prop.value();
-            return true;
+    if constexpr (Balance) {
+        v *= gain;
+    }
+    if constexpr (Contrast) {
+        v = (v - 128.0 * unit) * adj.contrastFactor + 128.0 * unit;
+    }
+    if constexpr (Brightness) {
+        v += adj.brightnessOffset * unit;
+    }
+    return v;
+}
+
+// Nearest 8-bit value for a 16-bit one
+inline int to8Bit(quint16 v)
+{
+    return (v * 255 + 32767) / 65535;
+}
+
+template <bool Brightness, bool Contrast, bool Balance, bool Color>
+void applyArgb32(const QImage& src, QImage& dst, const QRect& rect,
+                 const QPoint& to, const Adjustments& adj)
+{
+    auto clamp = [](int v) {
+        if (v < 0)   return 0;
+        if (v > 255) return 255;
+        return v;
+    };
+    auto curve = [&adj](int v, int channel) {
+        return int(toneCurve<Brightness, Contrast, Balance>(v, adj.gain[channel], adj, 1.0));
+    };
+
+    const int dx = to.x() - rect.left();
+    const int dy = to.y() - rect.top();
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        const QRgb* srcLine = reinterpret_cast<const QRgb*>(src.constScanLine(y));
+        QRgb*       dstLine = reinterpret_cast<QRgb*>(dst.scanLine(y + dy)) + dx;
+
+        for (int x = rect.left(); x <= rect.right(); ++x) {
+            QRgb p = srcLine[x];
+
+            int a = qAlpha(p);
+            int r = clamp(curve(qRed(p), 0));
+            int g = clamp(curve(qGreen(p), 1));
+            int b = clamp(curve(qBlue(p), 2));
+
+            if constexpr (Color) {
+                quint16 r16 = quint16(r * 257);
+                quint16 g16 = quint16(g * 257);
+                quint16 b16 = quint16(b * 257);
+                adj.display->map(r16, g16, b16);
+                r = to8Bit(r16);
+                g = to8Bit(g16);
+                b = to8Bit(b16);
+            }
+
+            dstLine[x] = qRgba(r, g, b, a);
         }
     }
-    return false;
+}
+
+template <bool Brightness, bool Contrast, bool Balance, bool Color>
+void applyRgba64(const QImage& src, QImage& dst, const QRect& rect,
+                 const QPoint& to, const Adjustments& adj)
+{
+    // Same curve as the 8-bit path, expressed in 16-bit units (1 step = 257).
+    // The curve only depends on the channel value, so it is tabulated once
+    // per call and every channel of every pixel becomes a single lookup;
+    // white balance needs one table per channel, otherwise they share one.
+    // The tables live per thread so re-renders do not allocate them again,
+    // and are only rebuilt when the parameters change (tiles share them).
+    static thread_local std::vector<quint16> lut(3 * 65536);
+    static thread_local int    lutKey = -1;
+    static thread_local double lutBrightness = 0.0;
+    static thread_local double lutContrast   = 0.0;
+    static thread_local double lutGain[3]    = { 0.0, 0.0, 0.0 };
+
+    const int key = (Brightness ? 1 : 0) | (Contrast ? 2 : 0) | (Balance ? 4 : 0);
+    const int tables = Balance ? 3 : 1;
+    if (key != lutKey || adj.brightnessOffset != lutBrightness ||
+        adj.contrastFactor != lutContrast ||
+        (Balance && (adj.gain[0] != lutGain[0] || adj.gain[1] != lutGain[1] ||
+                     adj.gain[2] != lutGain[2]))) {
+        for (int channel = 0; channel < tables; ++channel) {
+            quint16* table = lut.data() + channel * 65536;
+            for (int v = 0; v < 65536; ++v) {
+                const double out = toneCurve<Brightness, Contrast, Balance>(
+                    v, adj.gain[channel], adj, 257.0);
+                table[v] = quint16(qBound(0.0, out + 0.5, 65535.0));
+            }
+        }
+        lutKey        = key;
+        lutBrightness = adj.brightnessOffset;
+        lutContrast   = adj.contrastFactor;
+        std::copy(adj.gain, adj.gain + 3, lutGain);
+    }
+
+    const quint16* lutRed   = lut.data();
+    const quint16* lutGreen = lut.data() + (Balance ? 65536 : 0);
+    const quint16* lutBlue  = lut.data() + (Balance ? 2 * 65536 : 0);
+
+    const int dx = to.x() - rect.left();
+    const int dy = to.y() - rect.top();
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        const QRgba64* srcLine = reinterpret_cast<const QRgba64*>(src.constScanLine(y));
+        QRgba64*       dstLine = reinterpret_cast<QRgba64*>(dst.scanLine(y + dy)) + dx;
+
+        for (int x = rect.left(); x <= rect.right(); ++x) {
+            const QRgba64 p = srcLine[x];
+            quint16 r = lutRed[p.red()];
+            quint16 g = lutGreen[p.green()];
+            quint16 b = lutBlue[p.blue()];
+            if constexpr (Color) {
+                adj.display->map(r, g, b);
+            }
+            dstLine[x] = QRgba64::fromRgba64(r, g, b, p.alpha());
+        }
+    }
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+template <bool Brightness, bool Contrast, bool Balance, bool Color>
+void applyRgbaFloat(const QImage& src, QImage& dst, const QRect& rect,
+                    const QPoint& to, const Adjustments& adj)
+{
+    // Normalized [0, 1] channels. Values above 1.0 are kept so HDR headroom
+    // survives until the display conversion; only negatives are clipped.
+    const float unit = 1.0f / 255.0f;
+    auto curve = [&adj, unit](float v, int channel) {
+        return qMax(0.0f, float(toneCurve<Brightness, Contrast, Balance>(
+                              v, adj.gain[channel], adj, unit)));
+    };
+
+    const int dx = to.x() - rect.left();
+    const int dy = to.y() - rect.top();
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        const float* srcLine = reinterpret_cast<const float*>(src.constScanLine(y));
+        float*       dstLine = reinterpret_cast<float*>(dst.scanLine(y + dy)) + dx * 4;
+
+        for (int x = rect.left() * 4; x <= rect.right() * 4; x += 4) {
+            float r = curve(srcLine[x + 0], 0);
+            float g = curve(srcLine[x + 1], 1);
+            float b = curve(srcLine[x + 2], 2);
+
+            // The display conversion is where headroom above 1.0 ends
+            if constexpr (Color) {
+                quint16 r16 = quint16(qMin(r, 1.0f) * 65535.0f + 0.5f);
+                quint16 g16 = quint16(qMin(g, 1.0f) * 65535.0f + 0.5f);
+                quint16 b16 = quint16(qMin(b, 1.0f) * 65535.0f + 0.5f);
+                adj.display->map(r16, g16, b16);
+                r = r16 / 65535.0f;
+                g = g16 / 65535.0f;
+                b = b16 / 65535.0f;
+            }
+
+            dstLine[x + 0] = r;
+            dstLine[x + 1] = g;
+            dstLine[x + 2] = b;
+            dstLine[x + 3] = srcLine[x + 3];
+        }
+    }
+}
+#endif
+
+template <bool Brightness, bool Contrast, bool Balance, bool Color>
+void renderKernel(const QImage& src, QImage& dst, const QRect& rect,
+                  const QPoint& to, const Adjustments& adj)
+{
+    switch (src.format()) {
+    case QImage::Format_RGBA64:
+        applyRgba64<Brightness, Contrast, Balance, Color>(src, dst, rect, to, adj);
+        break;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+    case QImage::Format_RGBA32FPx4:
+        applyRgbaFloat<Brightness, Contrast, Balance, Color>(src, dst, rect, to, adj);
+        break;
+#endif
+    default:
+        applyArgb32<Brightness, Contrast, Balance, Color>(src, dst, rect, to, adj);
+        break;
+    }
+}
+
+template <bool Balance, bool Color>
+void renderKernel(bool brightness, bool contrast, const QImage& src, QImage& dst,
+                  const QRect& rect, const QPoint& to, const Adjustments& adj)
+{
+    if (brightness && contrast) {
+        renderKernel<true, true, Balance, Color>(src, dst, rect, to, adj);
+    } else if (brightness) {
+        renderKernel<true, false, Balance, Color>(src, dst, rect, to, adj);
+    } else if (contrast) {
+        renderKernel<false, true, Balance, Color>(src, dst, rect, to, adj);
+    } else {
+        renderKernel<false, false, Balance, Color>(src, dst, rect, to, adj);
+    }
+}
+
+template <bool Color>
+void renderKernel(bool brightness, bool contrast, bool balance, const QImage& src,
+                  QImage& dst, const QRect& rect, const QPoint& to,
+                  const Adjustments& adj)
+{
+    if (balance) {
+        renderKernel<true, Color>(brightness, contrast, src, dst, rect, to, adj);
+    } else {
+        renderKernel<false, Color>(brightness, contrast, src, dst, rect, to, adj);
+    }
+}
+
+} // namespace
+
+QImage::Format ImageProcessor::workingFormat(const QImage& image)
+{
+    return workingFormat(image.format());
+}
+
+QImage::Format ImageProcessor::workingFormat(QImage::Format format)
+{
+    switch (format) {
+    case QImage::Format_RGBX64:
+    case QImage::Format_RGBA64:
+    case QImage::Format_RGBA64_Premultiplied:
+    case QImage::Format_Grayscale16:
+    case QImage::Format_BGR30:
+    case QImage::Format_A2BGR30_Premultiplied:
+    case QImage::Format_RGB30:
+    case QImage::Format_A2RGB30_Premultiplied:
+        return QImage::Format_RGBA64;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+    case QImage::Format_RGBX16FPx4:
+    case QImage::Format_RGBA16FPx4:
+    case QImage::Format_RGBA16FPx4_Premultiplied:
+    case QImage::Format_RGBX32FPx4:
+    case QImage::Format_RGBA32FPx4:
+    case QImage::Format_RGBA32FPx4_Premultiplied:
+        return QImage::Format_RGBA32FPx4;
+#endif
+    default:
+        return QImage::Format_ARGB32;
+    }
 }
 
 QImage ImageProcessor::applyAll(const QImage& original,
-                                const QVector<ImageProperty>& properties)
+                                const PropertyTable& properties)
 {
     if (original.isNull()) {
         return QImage();
     }
 
+    // Callers rely on the working format even when nothing is edited
     QImage src = original;
-    if (src.format() != QImage::Format_ARGB32) {
-        src = src.convertToFormat(QImage::Format_ARGB32);
+    const QImage::Format format = workingFormat(src);
+    if (src.format() != format) {
+        src = src.convertToFormat(format);
     }
 
-    QImage dst(src.size(), QImage::Format_ARGB32);
+    if (properties.allNeutral()) {
+        return src;
+    }
 
-    // Defaults (neutral)
-    int brightnessSlider = 50;
-    int contrastSlider   = 50;
-    int tmp;
+    QImage dst(src.size(), format);
+    render(src, properties, dst, src.rect(), QPoint(0, 0), nullptr);
+    return dst;
+}
 
-    if (tryGetProperty(properties, PropertyId::Brightness, tmp)) {
-        brightnessSlider = tmp;
+void ImageProcessor::applyAll(const QImage& original,
+                              const PropertyTable& properties,
+                              QImage& dst,
+                              FrameBufferPool& pool)
+{
+    if (original.isNull()) {
+        dst = QImage();
+        return;
     }
-    if (tryGetProperty(properties, PropertyId::Contrast, tmp)) {
-        contrastSlider = tmp;
+
+    // ImageItem already stores its original in the working format, so this
+    // conversion only happens for images coming from elsewhere, such as
+    // decoder strips. It comes first: a neutral stack must still hand back
+    // the working format, which strip writers rely on.
+    QImage src = original;
+    const QImage::Format format = workingFormat(src);
+    if (src.format() != format) {
+        src = src.convertToFormat(format);
     }
 
-    // Map slider ranges to parameters
-    // Brightness: [-127, 127] ish
-    double brightnessOffset = (brightnessSlider - 50) * (255.0 / 100.0);
+    // Nothing to do: share the source and keep the old buffer for later
+    if (properties.allNeutral()) {
+        pool.recycle(dst);
+        dst = src;
+        return;
+    }
 
-    // Contrast: 50 -> 1.0, 0 -> 0.0, 100 -> 2.0
-    double contrastFactor = contrastSlider / 50.0;
-    if (contrastFactor < 0.0) contrastFactor = 0.0;
+    pool.prepare(dst, src.size(), format);
+    render(src, properties, dst, src.rect(), QPoint(0, 0), nullptr);
+}
 
-    auto clamp = [](int v) {
-        if (v < 0)   return 0;
-        if (v > 255) return 255;
-        return v;
-    };
+void ImageProcessor::applyRegion(const QImage& src,
+                                 const PropertyTable& properties,
+                                 QImage& dst,
+                                 const QRect& rect,
+                                 const QPoint& to,
+                                 const ColorLut* display)
+{
+    Q_ASSERT(src.format() == workingFormat(src));
+    Q_ASSERT(dst.format() == src.format());
 
-    int w = src.width();
-    int h = src.height();
+    const QRect area = rect & src.rect();
+    if (area.isEmpty()) {
+        return;
+    }
+    // Clipping the source moves the destination corner with it
+    const QPoint at = to + (area.topLeft() - rect.topLeft());
+    Q_ASSERT(dst.rect().contains(QRect(at, area.size())));
+    render(src, properties, dst, area, at, display);
+}
 
-    for (int y = 0; y < h; ++y) {
-        const QRgb* srcLine = reinterpret_cast<const QRgb*>(src.constScanLine(y));
-        QRgb*       dstLine = reinterpret_cast<QRgb*>(dst.scanLine(y));
+void ImageProcessor::convertForDisplay(const QImage& src, const QRect& rect, QImage& dst)
+{
+    Q_ASSERT(dst.format() == QImage::Format_ARGB32_Premultiplied);
+    Q_ASSERT(dst.size() == rect.size() && src.rect().contains(rect));
 
-        for (int x = 0; x < w; ++x) {
-            QRgb p = srcLine[x];
+    switch (src.format()) {
+    case QImage::Format_RGBA64:
+        for (int y = 0; y < rect.height(); ++y) {
+            const QRgba64* srcLine =
+                reinterpret_cast<const QRgba64*>(src.constScanLine(rect.top() + y)) + rect.left();
+            QRgb* dstLine = reinterpret_cast<QRgb*>(dst.scanLine(y));
+            for (int x = 0; x < rect.width(); ++x) {
+                dstLine[x] = srcLine[x].premultiplied().toArgb32();
+            }
+        }
+        break;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+    case QImage::Format_RGBA32FPx4: {
+        // HDR values beyond 1.0 clip here, not before
+        auto to8 = [](float v) { return qBound(0, int(v * 255.0f + 0.5f), 255); };
+        for (int y = 0; y < rect.height(); ++y) {
+            const float* srcLine =
+                reinterpret_cast<const float*>(src.constScanLine(rect.top() + y)) + rect.left() * 4;
+            QRgb* dstLine = reinterpret_cast<QRgb*>(dst.scanLine(y));
+            for (int x = 0; x < rect.width(); ++x) {
+                const float* p = srcLine + x * 4;
+                dstLine[x] = qPremultiply(qRgba(to8(p[0]), to8(p[1]), to8(p[2]), to8(p[3])));
+            }
+        }
+        break;
+    }
+#endif
+    default: {
+        QPainter painter(&dst);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(QPoint(0, 0), src, rect);
+        break;
+    }
+    }
+}
 
-            int a = qAlpha(p);
-            int r = qRed(p);
-            int g = qGreen(p);
-            int b = qBlue(p);
+double ImageProcessor::brightnessOffset(int slider)
+{
+    // Brightness: [-127, 127] ish
+    return (slider - 50) * (255.0 / 100.0);
+}
 
-            r = clamp(int((r - 128) * contrastFactor + 128 + brightnessOffset));
-            g = clamp(int((g - 128) * contrastFactor + 128 + brightnessOffset));
-            b = clamp(int((b - 128) * contrastFactor + 128 + brightnessOffset));
+double ImageProcessor::contrastFactor(int slider)
+{
+    // Contrast: 50 -> 1.0, 0 -> 0.0, 100 -> 2.0
+    return qMax(0.0, slider / 50.0);
+}
 
-            dstLine[x] = qRgba(r, g, b, a);
-        }
+void ImageProcessor::channelGains(int temperature, int tint, double gains[3])
+{
+    // Temperature trades red against blue, tint takes green away (magenta)
+    // or adds it; each reaches a gain of 0.5 to 1.5 at the slider ends
+    const double warm    = (temperature - 50) / 50.0;
+    const double magenta = (tint - 50) / 50.0;
+    gains[0] = 1.0 + 0.5 * warm;
+    gains[1] = 1.0 - 0.5 * magenta;
+    gains[2] = 1.0 - 0.5 * warm;
+}
+
+void ImageProcessor::render(const QImage& src,
+                            const PropertyTable& properties,
+                            QImage& dst,
+                            const QRect& rect,
+                            const QPoint& to,
+                            const ColorLut* display)
+{
+    Adjustments adj;
+    adj.brightnessOffset = brightnessOffset(properties.value(PropertyId::Brightness));
+    adj.contrastFactor   = contrastFactor(properties.value(PropertyId::Contrast));
+    channelGains(properties.value(PropertyId::Temperature),
+                 properties.value(PropertyId::Tint), adj.gain);
+    adj.display = display;
+
+    // Pick the kernel instantiation for the active operations; neutral ones
+    // are not evaluated per pixel at all. The display conversion runs in
+    // the same loop, on values still in registers.
+    const bool brightness = !properties.isNeutral(PropertyId::Brightness);
+    const bool contrast   = !properties.isNeutral(PropertyId::Contrast);
+    const bool balance    = !properties.isNeutral(PropertyId::Temperature) ||
+                            !properties.isNeutral(PropertyId::Tint);
+
+    if (display) {
+        renderKernel<true>(brightness, contrast, balance, src, dst, rect, to, adj);
+    } else {
+        renderKernel<false>(brightness, contrast, balance, src, dst, rect, to, adj);
     }
 
-    return dst;
+    const QColorSpace& space = display ? display->target() : src.colorSpace();
+    if (dst.colorSpace() != space) {
+        dst.setColorSpace(space);
+    }
 }
@@ -1,15 +1,87 @@
 #include "imageviewer.h"
 #include "./ui_imageviewer.h"
 
+#include <QComboBox>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QDir>
+#include <QLineEdit>
+#include <QMessageBox>
+#include <QProgressDialog>
+#include <QPushButton>
 #include <QPixmap>
+#include <QPainter>
 #include <QDebug>
 #include <QHBoxLayout>
 #include <QFrame>
 #include <QGroupBox>
+#include <QIcon>
 #include <QListView>
+#include <QMouseEvent>
 #include <QResizeEvent>
+#include <QColorSpace>
+#include <QFile>
+#include <QSet>
+#include <QSettings>
+#include <QScrollBar>
+#include <QStatusBar>
+#include <QThreadPool>
+#include <QWheelEvent>
+
+#include <algorithm>
+#include <cmath>
+
+#include "AnimationPlayer.h"
+#include "DuplicatesDialog.h"
+#include "ExportDialog.h"
+#include "HistogramLoader.h"
+#include "MemoryDialog.h"
+#include "MetadataLoader.h"
+#include "TileStreamer.h"
+#include "ProgressiveRenderer.h"
+#include "ThumbnailLoader.h"
+
+namespace {
+
+const char *DisplayProfileKey = "color/displayProfile";
+
+// List row that sorts by its image's metadata rather than by its text, so
+// sorting stays inside the model instead of moving items one at a time
+class ImageListItem : public QListWidgetItem
+{
+public:
+    ImageListItem(const QString &text, int imageIndex,
+                  const QVector<ImageMetadata> &metadata, const MetadataField &field)
+        : QListWidgetItem(text)
+        , m_imageIndex(imageIndex)
+        , m_metadata(metadata)
+        , m_field(field)
+    {}
+
+    bool operator<(const QListWidgetItem &other) const override
+    {
+        const auto &that = static_cast<const ImageListItem &>(other);
+        return MetadataIndex::lessThan(m_metadata[m_imageIndex],
+                                       m_metadata[that.m_imageIndex], m_field);
+    }
+
+private:
+    int                           m_imageIndex;
+    const QVector<ImageMetadata> &m_metadata;
+    const MetadataField          &m_field;
+};
+
+// Invalid when the file cannot be read or is not an RGB profile
+QColorSpace readIccProfile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QColorSpace();
+    }
+    return QColorSpace::fromIccProfile(file.readAll());
+}
+
+} // namespace
 
 ImageViewer::ImageViewer(QWidget *parent)
     : QMainWindow(parent)
@@ -26,12 +98,146 @@ ImageViewer::ImageViewer(QWidget *parent)
     connect(ui->actionOpen_Folder, &QAction::triggered,
             this, &ImageViewer::onOpenFolderClicked);
 
+    m_exporter = new ImageExporter(this);
+    connect(ui->actionExport, &QAction::triggered,
+            this, &ImageViewer::onExportClicked);
+    connect(m_exporter, &ImageExporter::progressChanged,
+            this, &ImageViewer::onExportProgress);
+    connect(m_exporter, &ImageExporter::finished,
+            this, &ImageViewer::onExportFinished);
+    connect(m_exporter, &ImageExporter::memoryInUseChanged,
+            this, &ImageViewer::onExportMemoryChanged);
+
+    registerCaches();
+    connect(ui->actionMemory_Usage, &QAction::triggered,
+            this, &ImageViewer::onMemoryUsageClicked);
+
+    m_renderer = new ProgressiveRenderer(m_framePool, m_memory, this);
+    loadDisplayProfile();
+    connect(ui->actionDisplay_Profile, &QAction::triggered,
+            this, &ImageViewer::onDisplayProfileClicked);
+    connect(ui->actionUse_sRGB_Display, &QAction::triggered,
+            this, &ImageViewer::onUseSrgbDisplayClicked);
+    connect(m_renderer, &ProgressiveRenderer::frameReady,
+            this, &ImageViewer::onRenderFrameReady);
+    connect(m_renderer, &ProgressiveRenderer::overviewReady,
+            this, &ImageViewer::onRenderOverviewReady);
+
+    m_player = new AnimationPlayer(m_framePool, this);
+    m_player->setDisplayColorSpace(m_renderer->displayColorSpace());
+    connect(m_player, &AnimationPlayer::frameReady,
+            this, &ImageViewer::onAnimationFrameReady);
+    connect(m_player, &AnimationPlayer::playbackStarted,
+            m_renderer, &ProgressiveRenderer::cancel);
+    connect(m_player, &AnimationPlayer::playbackFinished,
+            this, &ImageViewer::onAnimationFinished);
+
+    // Wheel zooms the preview, dragging pans it, double-click fits it again
+    ui->imageLabel->installEventFilter(this);
+
+    m_metadataLoader = new MetadataLoader(this);
+    connect(m_metadataLoader, &MetadataLoader::folderListed,
+            this, &ImageViewer::onFolderListed);
+    connect(m_metadataLoader, &MetadataLoader::metadataReady,
+            this, &ImageViewer::onMetadataReady);
+    connect(m_metadataLoader, &MetadataLoader::finished,
+            this, &ImageViewer::onMetadataFinished);
+
+    m_thumbnailLoader = new ThumbnailLoader(this);
+    connect(m_thumbnailLoader, &ThumbnailLoader::thumbnailReady,
+            this, &ImageViewer::onThumbnailReady);
+
+    m_histogramLoader = new HistogramLoader(this);
+    connect(m_histogramLoader, &HistogramLoader::histogramReady,
+            this, &ImageViewer::onHistogramReady);
+
+    m_thumbnailRestoreTimer.setSingleShot(true);
+    m_thumbnailRestoreTimer.setInterval(150);
+    connect(&m_thumbnailRestoreTimer, &QTimer::timeout,
+            this, &ImageViewer::restoreThumbnails);
+    connect(ui->folderListWidget->verticalScrollBar(), &QScrollBar::valueChanged,
+            &m_thumbnailRestoreTimer, QOverload<>::of(&QTimer::start));
+
+    m_duplicateFinder = new DuplicateFinder(this);
+    connect(ui->actionFind_Duplicates, &QAction::triggered,
+            this, &ImageViewer::onFindDuplicatesClicked);
+    connect(m_duplicateFinder, &DuplicateFinder::progressChanged,
+            this, &ImageViewer::onDuplicateScanProgress);
+    connect(m_duplicateFinder, &DuplicateFinder::finished,
+            this, &ImageViewer::onDuplicateScanFinished);
+
     connect(ui->folderListWidget, &QListWidget::itemClicked,
             this, &ImageViewer::onImageSelected);
 }
 
+void ImageViewer::registerCaches()
+{
+    // Cheap caches are registered with a low cost so they go first. The
+    // item on screen keeps its decode and previews whatever their age.
+    m_decodedCache = m_memory.registerCache(tr("Decoded images"), MemoryManager::Cost::Decode,
+                                            [this](quint64 key) {
+        const int index = int(key);
+        if (index >= m_images.size()) {
+            return true;
+        }
+        if (index == m_currentImageIndex) {
+            return false;
+        }
+        m_memory.remove(m_previewCache, key);
+        return m_images[index].unload();
+    });
+
+    m_previewCache = m_memory.registerCache(tr("Preview levels"), MemoryManager::Cost::Preview,
+                                            [this](quint64 key) {
+        const int index = int(key);
+        if (index >= m_images.size()) {
+            return true;
+        }
+        if (index == m_currentImageIndex) {
+            return false;
+        }
+        m_images[index].releasePyramid();
+        return true;
+    });
+
+    m_thumbnailCache = m_memory.registerCache(tr("Thumbnails"), MemoryManager::Cost::Preview,
+                                              [this](quint64 key) {
+        const int index = int(key);
+        if (index >= m_listItems.size()) {
+            return true;
+        }
+        if (isRowVisible(m_listItems[index])) {
+            return false;
+        }
+        m_listItems[index]->setIcon(QIcon());
+        m_thumbnailStates[index] = ThumbnailState::Evicted;
+        return true;
+    });
+
+    m_spareCache = m_memory.registerCache(tr("Idle frame buffers"), MemoryManager::Cost::Spare,
+                                          [this](quint64) {
+        m_framePool.clear();
+        return true;
+    });
+
+    // Accounted only: the label always needs its pixmap
+    m_displayCache = m_memory.registerCache(tr("Display pixmap"), MemoryManager::Cost::Decode,
+                                            [](quint64) { return false; });
+
+    // Also accounted only: both are bounded and free themselves when done
+    m_animationCache = m_memory.registerCache(tr("Animation frames"), MemoryManager::Cost::Render,
+                                              [this](quint64) { return !m_player->isPlaying(); });
+    m_exportCache = m_memory.registerCache(tr("Export working images"), MemoryManager::Cost::Render,
+                                           [this](quint64) { return !m_exporter->isRunning(); });
+}
+
 ImageViewer::~ImageViewer()
 {
+    // Pyramid builds report back to us from the global pool
+    QThreadPool::globalInstance()->waitForDone();
+
+    // The label outlives the player and renderer during teardown
+    ui->imageLabel->removeEventFilter(this);
     delete ui;
 }
 
@@ -55,17 +261,9 @@ void ImageViewer::rebuildPropertiesUI(ImageItem &item)
 {
     clearPropertiesUI();
 
-    if (m_histogramWidget) {
-        m_histogramWidget->setImage(item.editedImage());
-    }
-
-    const QVector<ImageProperty> &props = item.properties();
+    const PropertyTable &props = item.properties();
 
     for (const ImageProperty &prop : props) {
-        if (prop.id() != PropertyId::Brightness &&
-            prop.id() != PropertyId::Contrast)
-            continue;
-
         QFrame *controlCard = new QFrame(ui->propertiesPanel);
         controlCard->setObjectName("propertyCard");
 
@@ -101,7 +299,35 @@ void ImageViewer::rebuildPropertiesUI(ImageItem &item)
 
         connect(slider, &QSlider::valueChanged,
                 this, &ImageViewer::onPropertySliderChanged);
+        connect(slider, &QSlider::sliderPressed,
+                this, &ImageViewer::onPropertySliderPressed);
+        connect(slider, &QSlider::sliderReleased,
+                this, &ImageViewer::onPropertySliderReleased);
+    }
+
+    // Auto buttons act on the whole selection, not just this image
+    QWidget *autoRow = new QWidget(ui->propertiesPanel);
+    auto *autoLayout = new QHBoxLayout(autoRow);
+    autoLayout->setContentsMargins(0, 0, 0, 0);
+    autoLayout->setSpacing(8);
+
+    const struct {
+        const char *label;
+        AutoAdjust::Mode mode;
+    } autoModes[] = {
+        { QT_TR_NOOP("Auto Levels"),        AutoAdjust::Mode::Levels },
+        { QT_TR_NOOP("Auto Contrast"),      AutoAdjust::Mode::Contrast },
+        { QT_TR_NOOP("Auto White Balance"), AutoAdjust::Mode::WhiteBalance },
+    };
+    for (const auto &autoMode : autoModes) {
+        QPushButton *button = new QPushButton(tr(autoMode.label), autoRow);
+        const AutoAdjust::Mode mode = autoMode.mode;
+        connect(button, &QPushButton::clicked, this, [this, mode]() {
+            autoAdjustSelection(mode);
+        });
+        autoLayout->addWidget(button);
     }
+    m_adjustmentsLayout->addWidget(autoRow);
 
     m_adjustmentsLayout->addStretch();
 }
@@ -118,13 +344,26 @@ void ImageViewer::onOpenFolderClicked()
         return;
     }
 
-    QDir dir(folderPath);
-    QStringList filters = {"*.jpg", "*.png", "*.gif", "*.bmp", "*.jpeg"};
-    QStringList files = dir.entryList(filters, QDir::Files);
+    m_renderer->cancel();
+    m_player->stop();
+    m_memory.remove(m_animationCache, 0);
+    m_duplicateFinder->cancel();
+    m_thumbnailLoader->cancel();
+    m_metadataLoader->cancel();
+    m_histogramLoader->cancel();
+    m_pendingAutoAdjust.clear();
+    m_lateAutoAdjusted = 0;
+    m_folderPath = folderPath;
 
     ui->folderListWidget->clear();
     m_images.clear();
+    m_metadata.clear();
+    m_listItems.clear();
+    m_thumbnailStates.clear();
     m_currentImageIndex = -1;
+    m_memory.removeAll(m_decodedCache);
+    m_memory.removeAll(m_previewCache);
+    m_memory.removeAll(m_thumbnailCache);
 
     clearPropertiesUI();
     ui->imageLabel->setText("Select an image to preview");
@@ -134,34 +373,184 @@ void ImageViewer::onOpenFolderClicked()
     }
     showPropertiesEmptyState();
 
-    for (const QString &fileName : files) {
-        QString fullPath = dir.absoluteFilePath(fileName);
+    // Only file headers are read, on a worker; rows appear as they arrive.
+    // Pixels are decoded when an image is selected, and thumbnails come
+    // from the background loader.
+    statusBar()->showMessage(tr("Reading folder..."));
+    m_metadataLoader->start(folderPath);
+}
+
+void ImageViewer::onFolderListed(int generation, int count)
+{
+    if (generation != m_metadataLoader->generation()) {
+        return;
+    }
+
+    // The renderer keeps a pointer to the item on screen, so the vector
+    // must not move while the list fills in
+    m_images.reserve(count);
+    m_metadata.reserve(count);
+    m_listItems.reserve(count);
+    m_thumbnailStates.reserve(count);
+}
+
+void ImageViewer::onMetadataReady(int generation, const QVector<ImageMetadata> &batch)
+{
+    if (generation != m_metadataLoader->generation()) {
+        return;
+    }
+
+    const bool firstBatch = m_images.isEmpty();
+    const bool moves = m_images.size() + batch.size() > m_images.capacity();
+    if (moves) {
+        m_renderer->cancel();
+    }
 
-        QImage img(fullPath);
-        if (img.isNull()) {
-            qDebug() << "Failed to load image:" << fullPath;
+    const QDir dir(m_folderPath);
+    const QString filter = m_filterEdit ? m_filterEdit->text().trimmed() : QString();
+    QListWidget *list = ui->folderListWidget;
+    list->setUpdatesEnabled(false);
+    for (const ImageMetadata &md : batch) {
+        const QString path = dir.filePath(md.fileName);
+        if (!md.size.isValid()) {
+            qDebug() << "Failed to read image header:" << path;
             continue;
         }
 
-        // Now ImageItem is purely an in-memory document
-        m_images.push_back(ImageItem(img));
+        m_images.push_back(ImageItem(path, md.orientedSize()));
+        m_metadata.push_back(md);
         int index = m_images.length() - 1;
 
-        QListWidgetItem *item = new QListWidgetItem(fileName);
+        QStringList details = MetadataIndex::details(md);
+        if (TileStreamer::decodedBytes(md.size, QImage::Format_ARGB32) > TileStreamer::inMemoryLimit()) {
+            details << tr("previewed at reduced size");
+        }
+
+        QListWidgetItem *item = new ImageListItem(md.fileName, index, m_metadata, m_sortField);
+        item->setToolTip(details.join(", "));
         item->setData(Qt::UserRole, index);
-        item->setIcon(QPixmap::fromImage(img).scaled(56, 56,
-                                                     Qt::KeepAspectRatio,
-                                                     Qt::SmoothTransformation));
         item->setSizeHint(QSize(item->sizeHint().width(), 68));
-        ui->folderListWidget->addItem(item);
+        list->addItem(item);
+        item->setHidden(!MetadataIndex::matches(md, filter));
+        m_listItems.push_back(item);
+        m_thumbnailStates.push_back(ThumbnailState::Pending);
+    }
+    list->setUpdatesEnabled(true);
+
+    // Rows are appended as they arrive and sorted once the folder is
+    // complete; sorting every batch would make large folders quadratic
+    if (moves && m_currentImageIndex >= 0) {
+        renderCurrentImage();
+    }
+
+    // The first rows get thumbnails and a selection straight away; the
+    // rest are queued once the whole folder is known
+    if (firstBatch && !m_images.isEmpty()) {
+        startThumbnails();
+        for (int row = 0; row < list->count(); ++row) {
+            QListWidgetItem *item = list->item(row);
+            if (!item->isHidden()) {
+                list->setCurrentItem(item);
+                onImageSelected(item);
+                break;
+            }
+        }
+    }
+}
+
+void ImageViewer::onMetadataFinished(int generation)
+{
+    if (generation != m_metadataLoader->generation()) {
+        return;
+    }
+    statusBar()->showMessage(tr("%n image(s)", "", m_images.size()), 3000);
+    applySort();
+    startThumbnails();
+}
+
+void ImageViewer::applySort()
+{
+    if (!m_sortCombo) {
+        return;
+    }
+
+    // Rows compare through their metadata (see ImageListItem), so this is
+    // one sort inside the model; hidden rows and the selection follow
+    m_sortField = MetadataField(m_sortCombo->currentData().toInt());
+    ui->folderListWidget->sortItems(Qt::AscendingOrder);
+
+    // Rows that came into view may have lost their thumbnails
+    m_thumbnailRestoreTimer.start();
+}
+
+void ImageViewer::applyFilter()
+{
+    const QString filter = m_filterEdit ? m_filterEdit->text().trimmed() : QString();
+
+    for (int row = 0; row < ui->folderListWidget->count(); ++row) {
+        QListWidgetItem *item = ui->folderListWidget->item(row);
+        const int imageIndex = item->data(Qt::UserRole).toInt();
+        item->setHidden(!MetadataIndex::matches(m_metadata[imageIndex], filter));
+    }
+
+    // Rows that came into view may have lost their thumbnails
+    m_thumbnailRestoreTimer.start();
+}
+
+void ImageViewer::startThumbnails()
+{
+    // Queue in display order so the top of the list fills in first. Evicted
+    // thumbnails only come back while their row is on screen, or they would
+    // push each other out again.
+    QStringList paths;
+    QVector<int> ids;
+    for (int row = 0; row < ui->folderListWidget->count(); ++row) {
+        QListWidgetItem *item = ui->folderListWidget->item(row);
+        const int imageIndex = item->data(Qt::UserRole).toInt();
+        const ThumbnailState state = m_thumbnailStates[imageIndex];
+        if (state == ThumbnailState::Loaded ||
+            (state == ThumbnailState::Evicted && !isRowVisible(item))) {
+            continue;
+        }
+        paths << m_images[imageIndex].sourcePath();
+        ids << imageIndex;
     }
+    m_thumbnailLoader->start(m_folderPath, paths, ids);
+}
 
-    if (ui->folderListWidget->count() > 0) {
-        ui->folderListWidget->setCurrentRow(0);
-        onImageSelected(ui->folderListWidget->currentItem());
+void ImageViewer::restoreThumbnails()
+{
+    // Restarting the loader abandons its batch, so only do it when a
+    // visible row is actually missing its thumbnail
+    for (int imageIndex = 0; imageIndex < m_listItems.size(); ++imageIndex) {
+        if (m_thumbnailStates[imageIndex] == ThumbnailState::Evicted &&
+            isRowVisible(m_listItems[imageIndex])) {
+            startThumbnails();
+            return;
+        }
     }
 }
 
+bool ImageViewer::isRowVisible(const QListWidgetItem *item) const
+{
+    const QListWidget *list = ui->folderListWidget;
+    return !item->isHidden() && list->visualItemRect(item).intersects(list->viewport()->rect());
+}
+
+void ImageViewer::onThumbnailReady(int generation, int imageIndex, const QImage &thumbnail,
+                                   const HistogramStats &histogram)
+{
+    if (generation != m_thumbnailLoader->generation() ||
+        imageIndex < 0 || imageIndex >= m_listItems.size()) {
+        return;
+    }
+    // Kept for the auto adjustments, which then need no pixels at all
+    m_images[imageIndex].setHistogram(histogram);
+    m_listItems[imageIndex]->setIcon(QPixmap::fromImage(thumbnail));
+    m_thumbnailStates[imageIndex] = ThumbnailState::Loaded;
+    m_memory.touch(m_thumbnailCache, quint64(imageIndex), thumbnail.sizeInBytes());
+}
+
 void ImageViewer::onImageSelected(QListWidgetItem *item)
 {
     if (!item) {
@@ -176,12 +565,29 @@ void ImageViewer::onImageSelected(QListWidgetItem *item)
         return;
     }
 
+    m_renderer->cancel();
+    m_player->stop();
+    m_memory.remove(m_animationCache, 0);
     m_currentImageIndex = imageIndex;
     ImageItem &imgAtIndex = m_images[imageIndex];
+    if (!imgAtIndex.load()) {
+        qDebug() << "Failed to load image:" << imgAtIndex.sourcePath();
+    } else if (imgAtIndex.isProxy()) {
+        const QSize full = imgAtIndex.fullSize();
+        const QSize shown = imgAtIndex.originalImage().size();
+        statusBar()->showMessage(tr("%1 x %2 image, previewed at %3 x %4")
+                                     .arg(full.width()).arg(full.height())
+                                     .arg(shown.width()).arg(shown.height()), 5000);
+    }
+    m_memory.touch(m_decodedCache, quint64(imageIndex), imgAtIndex.imageBytes());
 
-    const QImage &img = imgAtIndex.editedImage(); // original if no edits
+    // Each image opens fitted to the view
+    m_zoom = 1.0;
+    m_viewCentre = QPointF(0.5, 0.5);
+
+    const QImage &img = imgAtIndex.originalImage();
     if (!img.isNull()) {
-        updateDisplayedImage(img);
+        renderCurrentImage();
     } else {
         qDebug() << "Image is null at selected index";
         ui->imageLabel->setText("Unable to preview image");
@@ -193,6 +599,12 @@ void ImageViewer::onImageSelected(QListWidgetItem *item)
     }
 
     rebuildPropertiesUI(imgAtIndex);
+
+    // The still above is the first frame; the player takes over the display
+    // only if the decoder finds a second one
+    if (!img.isNull() && AnimationPlayer::isAnimated(imgAtIndex.sourcePath())) {
+        m_player->play(imgAtIndex.sourcePath(), imgAtIndex.properties());
+    }
 }
 
 void ImageViewer::onPropertySliderChanged(int value)
@@ -234,20 +646,582 @@ void ImageViewer::onPropertySliderChanged(int value)
         return;
     }
 
-    // 2) Recompute edited image using the processor
-    QImage newEdited = ImageProcessor::applyAll(
-        imgItem.originalImage(),
-        imgItem.properties()
-        );
-    imgItem.setEditedImage(newEdited);
+    // Animations apply edits per frame as they play
+    m_player->setProperties(imgItem.properties());
+    if (m_player->isPlaying()) {
+        return;
+    }
 
-    // 3) Display the new edited image
-    const QImage &img = imgItem.editedImage();
-    if (!img.isNull()) {
-        updateDisplayedImage(img);
+    // 2) Re-render what is on screen progressively: a coarse preview shows
+    //    right away and is refined tile by tile (see onRenderFrameReady)
+    renderCurrentImage();
+}
+
+void ImageViewer::autoAdjustSelection(AutoAdjust::Mode mode)
+{
+    QVector<int> indexes;
+    for (QListWidgetItem *item : ui->folderListWidget->selectedItems()) {
+        bool ok = false;
+        int imageIndex = item->data(Qt::UserRole).toInt(&ok);
+        if (ok && imageIndex >= 0 && imageIndex < m_images.size()) {
+            indexes.push_back(imageIndex);
+        }
+    }
+    if (indexes.isEmpty() && m_currentImageIndex >= 0 &&
+        m_currentImageIndex < m_images.size()) {
+        indexes.push_back(m_currentImageIndex);
+    }
+    if (indexes.isEmpty()) {
+        return;
+    }
+
+    // Images whose thumbnail has not arrived yet are analysed on a worker
+    // and adjusted when their histogram lands; the rest are adjusted now
+    QVector<int> missing;
+    QStringList missingPaths;
+    int adjusted = 0;
+    for (int imageIndex : indexes) {
+        if (m_images[imageIndex].histogram()) {
+            applyAutoAdjust(imageIndex, mode);
+            ++adjusted;
+        } else {
+            m_pendingAutoAdjust.insert(imageIndex, mode);
+            missing.push_back(imageIndex);
+            missingPaths << m_images[imageIndex].sourcePath();
+        }
+    }
+    if (!missing.isEmpty()) {
+        m_histogramLoader->start(m_folderPath, missingPaths, missing);
+    }
+
+    QString message;
+    switch (mode) {
+    case AutoAdjust::Mode::Levels:
+        message = tr("Auto levels applied to %n image(s)", "", adjusted);
+        break;
+    case AutoAdjust::Mode::Contrast:
+        message = tr("Auto contrast applied to %n image(s)", "", adjusted);
+        break;
+    case AutoAdjust::Mode::WhiteBalance:
+        message = tr("Auto white balance applied to %n image(s)", "", adjusted);
+        break;
+    }
+    if (!missing.isEmpty()) {
+        message += tr(", analyzing %n more", "", missing.size());
+    }
+    statusBar()->showMessage(message, 5000);
+}
+
+void ImageViewer::applyAutoAdjust(int imageIndex, AutoAdjust::Mode mode)
+{
+    ImageItem &item = m_images[imageIndex];
+    PropertyTable properties = item.properties();
+    AutoAdjust::apply(mode, *item.histogram(), properties);
+    for (const ImageProperty &prop : properties) {
+        item.setPropertyValue(prop.id(), prop.value());
+    }
+
+    if (imageIndex == m_currentImageIndex) {
+        rebuildPropertiesUI(item);
+        m_player->setProperties(item.properties());
+        if (!m_player->isPlaying() && !item.originalImage().isNull()) {
+            renderCurrentImage();
+        }
     }
 }
 
+void ImageViewer::onHistogramReady(int generation, int imageIndex,
+                                   const HistogramStats &histogram)
+{
+    if (generation != m_histogramLoader->generation() ||
+        imageIndex < 0 || imageIndex >= m_images.size()) {
+        return;
+    }
+
+    ImageItem &item = m_images[imageIndex];
+    if (!item.histogram()) {
+        item.setHistogram(histogram);
+    }
+
+    auto it = m_pendingAutoAdjust.find(imageIndex);
+    if (it == m_pendingAutoAdjust.end()) {
+        return;
+    }
+    const AutoAdjust::Mode mode = it.value();
+    m_pendingAutoAdjust.erase(it);
+    if (item.histogram()) {
+        applyAutoAdjust(imageIndex, mode);
+        ++m_lateAutoAdjusted;
+    }
+
+    if (m_pendingAutoAdjust.isEmpty()) {
+        statusBar()->showMessage(tr("Auto adjustments applied to %n more image(s)", "",
+                                    m_lateAutoAdjusted), 5000);
+        m_lateAutoAdjusted = 0;
+    }
+}
+
+void ImageViewer::onPropertySliderPressed()
+{
+    m_sliderDragging = true;
+    m_dragFrames = 0;
+}
+
+void ImageViewer::onPropertySliderReleased()
+{
+    // The first frame of a drag may size new buffers; every later one must
+    // find them in the pool
+    Q_ASSERT_X(!m_sliderDragging || m_dragFrames <= 1 ||
+                   m_framePool.allocations() == m_dragAllocations,
+               "ImageViewer", "frame buffers allocated while dragging a slider");
+    m_sliderDragging = false;
+}
+
+void ImageViewer::onRenderFrameReady(const QImage &image, const QRectF &sourceRect)
+{
+    if (!image.isNull()) {
+        updateDisplayedImage(image, sourceRect);
+    }
+}
+
+void ImageViewer::onRenderOverviewReady(const QImage &overview)
+{
+    // 3) The histogram follows the whole frame, not just the visible part
+    if (m_histogramWidget) {
+        m_histogramWidget->setImage(overview);
+    }
+}
+
+void ImageViewer::onAnimationFrameReady(const QImage &frame)
+{
+    if (!frame.isNull()) {
+        updateDisplayedImage(frame);
+    }
+    m_memory.touch(m_animationCache, 0, m_player->bufferedBytes());
+}
+
+void ImageViewer::onAnimationFinished()
+{
+    // Back to the still, which zooms, pans and feeds the histogram
+    m_memory.remove(m_animationCache, 0);
+    renderCurrentImage();
+}
+
+void ImageViewer::onExportMemoryChanged(qint64 bytes)
+{
+    if (bytes > 0) {
+        m_memory.touch(m_exportCache, 0, bytes);
+    } else {
+        m_memory.remove(m_exportCache, 0);
+    }
+}
+
+void ImageViewer::buildPyramid(int imageIndex)
+{
+    // Reported from a pool thread; the selection may have moved on by then
+    m_images[imageIndex].buildPyramid([this, imageIndex]() {
+        QMetaObject::invokeMethod(this, [this, imageIndex]() {
+            if (imageIndex == m_currentImageIndex) {
+                renderCurrentImage();
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ImageViewer::renderCurrentImage()
+{
+    if (m_currentImageIndex < 0 || m_currentImageIndex >= m_images.size()) {
+        return;
+    }
+
+    ImageItem &item = m_images[m_currentImageIndex];
+    if (!item.isPyramidReady()) {
+        // The levels are built off-thread and trigger this again when
+        // ready; meanwhile the unedited original stands in
+        buildPyramid(m_currentImageIndex);
+        if (!item.originalImage().isNull()) {
+            updateDisplayedImage(item.originalImage(), visibleImageRect(item));
+        }
+        return;
+    }
+    m_renderer->render(&item, ui->imageLabel->size(), visibleImageRect(item));
+
+    // Rendering cycles frame buffers
+    m_memory.touch(m_previewCache, quint64(m_currentImageIndex), item.pyramidBytes());
+    m_memory.touch(m_spareCache, 0, m_framePool.idleBytes());
+}
+
+QRectF ImageViewer::visibleImageRect(const ImageItem &item) const
+{
+    const QSizeF image = item.originalImage().size();
+    const QSizeF view = ui->imageLabel->size();
+    if (image.isEmpty() || view.isEmpty()) {
+        return QRectF();
+    }
+
+    // Zoom 1 fits the whole image; beyond that the view shows a part of it
+    const qreal fit = qMin(view.width() / image.width(), view.height() / image.height());
+    const qreal scale = fit * m_zoom;
+    const QSizeF size(qMin(image.width(), view.width() / scale),
+                      qMin(image.height(), view.height() / scale));
+
+    // Keep the view inside the image
+    const qreal x = qBound(qreal(0), m_viewCentre.x() * image.width() - size.width() / 2,
+                           image.width() - size.width());
+    const qreal y = qBound(qreal(0), m_viewCentre.y() * image.height() - size.height() / 2,
+                           image.height() - size.height());
+    return QRectF(QPointF(x, y), size);
+}
+
+QRectF ImageViewer::displayedRect(const QRectF &visible) const
+{
+    // Where updateDisplayedImage puts `visible` inside the label
+    const QSizeF target = visible.size().scaled(ui->imageLabel->size(), Qt::KeepAspectRatio);
+    const QSizeF view = ui->imageLabel->size();
+    return QRectF(QPointF((view.width() - target.width()) / 2,
+                          (view.height() - target.height()) / 2), target);
+}
+
+void ImageViewer::zoomAt(double factor, const QPointF &labelPos)
+{
+    if (m_currentImageIndex < 0 || m_currentImageIndex >= m_images.size()) {
+        return;
+    }
+
+    const ImageItem &item = m_images[m_currentImageIndex];
+    const QRectF visible = visibleImageRect(item);
+    if (visible.isEmpty()) {
+        return;
+    }
+
+    const double zoom = qBound(1.0, m_zoom * factor, 64.0);
+    if (qFuzzyCompare(zoom, m_zoom)) {
+        return;
+    }
+
+    // Keep the image point under the cursor where it is
+    const QRectF shown = displayedRect(visible);
+    const QPointF anchor(visible.left() + (labelPos.x() - shown.left()) * visible.width() / shown.width(),
+                         visible.top() + (labelPos.y() - shown.top()) * visible.height() / shown.height());
+    const QPointF centre = anchor + (visible.center() - anchor) * (m_zoom / zoom);
+
+    const QSizeF image = item.originalImage().size();
+    m_zoom = zoom;
+    m_viewCentre = QPointF(centre.x() / image.width(), centre.y() / image.height());
+    renderCurrentImage();
+}
+
+void ImageViewer::panBy(const QPoint &delta)
+{
+    if (m_currentImageIndex < 0 || m_currentImageIndex >= m_images.size()) {
+        return;
+    }
+
+    const ImageItem &item = m_images[m_currentImageIndex];
+    const QRectF visible = visibleImageRect(item);
+    if (visible.isEmpty()) {
+        return;
+    }
+
+    // Drag distance in label pixels, converted to image pixels
+    const QRectF shown = displayedRect(visible);
+    const QSizeF image = item.originalImage().size();
+    const QPointF moved(delta.x() * visible.width() / shown.width(),
+                        delta.y() * visible.height() / shown.height());
+    const QPointF centre(m_panCentre.x() * image.width() - moved.x(),
+                         m_panCentre.y() * image.height() - moved.y());
+    m_viewCentre = QPointF(centre.x() / image.width(), centre.y() / image.height());
+
+    // Store the clamped centre so dragging past an edge does not build up
+    const QRectF clamped = visibleImageRect(item);
+    m_viewCentre = QPointF(clamped.center().x() / image.width(),
+                           clamped.center().y() / image.height());
+    renderCurrentImage();
+}
+
+void ImageViewer::onExportClicked()
+{
+    if (m_exporter->isRunning()) {
+        QMessageBox::information(this, tr("Export"),
+                                 tr("An export is already in progress."));
+        return;
+    }
+
+    QVector<int> indexes;
+    for (QListWidgetItem *item : ui->folderListWidget->selectedItems()) {
+        bool ok = false;
+        int imageIndex = item->data(Qt::UserRole).toInt(&ok);
+        if (ok && imageIndex >= 0 && imageIndex < m_images.size()) {
+            indexes.push_back(imageIndex);
+        }
+    }
+    if (indexes.isEmpty() && m_currentImageIndex >= 0 &&
+        m_currentImageIndex < m_images.size()) {
+        indexes.push_back(m_currentImageIndex);
+    }
+    if (indexes.isEmpty()) {
+        return;
+    }
+
+    ExportDialog dialog(indexes.size(), this);
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+    const QString suffix = dialog.format();
+
+    // "a.jpg" and "a.png" would both become "a_edited.<suffix>", and an
+    // earlier export may be in the folder already; number the name until
+    // it is new so nothing is overwritten
+    QSet<QString> usedNames;
+    auto targetName = [&suffix, &usedNames](const QDir &dir, const QString &sourcePath) {
+        const QString base = QFileInfo(sourcePath).completeBaseName() + "_edited";
+        QString name = base + "." + suffix;
+        for (int n = 2; usedNames.contains(name.toLower()) || dir.exists(name); ++n) {
+            name = QString("%1_%2.%3").arg(base).arg(n).arg(suffix);
+        }
+        usedNames.insert(name.toLower());
+        return name;
+    };
+
+    QDir targetDir;
+    QString singleTarget;
+    const QString firstSource = m_images[indexes.first()].sourcePath();
+
+    if (indexes.size() == 1) {
+        const QDir sourceDir = QFileInfo(firstSource).dir();
+        singleTarget = QFileDialog::getSaveFileName(
+            this,
+            tr("Export Image"),
+            sourceDir.filePath(targetName(sourceDir, firstSource)),
+            tr("%1 image (*.%2)").arg(suffix.toUpper(), suffix)
+            );
+        if (singleTarget.isEmpty()) {
+            return;
+        }
+
+        // The writer picks the format from the suffix. The dialog has
+        // already confirmed overwriting the name as typed, but not with
+        // the suffix added.
+        if (QFileInfo(singleTarget).suffix().isEmpty()) {
+            singleTarget += "." + suffix;
+            if (QFileInfo::exists(singleTarget) &&
+                QMessageBox::question(this, tr("Export Image"),
+                                      tr("%1 already exists. Replace it?")
+                                          .arg(QFileInfo(singleTarget).fileName()))
+                    != QMessageBox::Yes) {
+                return;
+            }
+        }
+    } else {
+        const QString dirPath = QFileDialog::getExistingDirectory(
+            this,
+            tr("Export To Folder"),
+            QFileInfo(firstSource).absolutePath()
+            );
+        if (dirPath.isEmpty()) {
+            return;
+        }
+        targetDir = QDir(dirPath);
+    }
+
+    // Only the source path and a snapshot of the edit settings go to the
+    // workers; they decode and render the full resolution image themselves
+    QVector<ExportRequest> requests;
+    for (int imageIndex : indexes) {
+        const ImageItem &imgItem = m_images[imageIndex];
+        ExportRequest request;
+        request.sourcePath = imgItem.sourcePath();
+        request.targetPath = singleTarget.isEmpty()
+                                 ? targetDir.filePath(targetName(targetDir, imgItem.sourcePath()))
+                                 : singleTarget;
+        request.properties = imgItem.properties();
+        requests.push_back(request);
+    }
+
+    if (!m_exportProgress) {
+        m_exportProgress = new QProgressDialog(this);
+        m_exportProgress->setWindowTitle(tr("Export"));
+        m_exportProgress->setAutoClose(false);
+        m_exportProgress->setAutoReset(false);
+        m_exportProgress->setMinimumDuration(0);
+        connect(m_exportProgress, &QProgressDialog::canceled,
+                m_exporter, &ImageExporter::cancel);
+    }
+    m_exportProgress->setLabelText(tr("Exporting %n image(s)...", "", requests.size()));
+    m_exportProgress->setRange(0, 0);
+    m_exportProgress->show();
+
+    // Leave the viewer's own caches room next to the export jobs
+    m_exporter->setMemoryBudget(m_memory.budget() / 2);
+    m_exporter->start(requests, dialog.quality());
+}
+
+void ImageViewer::onExportProgress(int value, int maximum)
+{
+    if (m_exportProgress) {
+        m_exportProgress->setRange(0, maximum);
+        m_exportProgress->setValue(value);
+    }
+}
+
+void ImageViewer::onExportFinished(int exported, const QStringList &errors)
+{
+    if (m_exportProgress) {
+        m_exportProgress->hide();
+    }
+
+    statusBar()->showMessage(tr("Exported %n image(s)", "", exported), 5000);
+
+    if (!errors.isEmpty()) {
+        QMessageBox::warning(this, tr("Export"), errors.join("\n"));
+    }
+}
+
+void ImageViewer::onMemoryUsageClicked()
+{
+    if (!m_memoryDialog) {
+        m_memoryDialog = new MemoryDialog(m_memory, m_framePool, this);
+    }
+    m_memoryDialog->show();
+    m_memoryDialog->raise();
+    m_memoryDialog->activateWindow();
+}
+
+void ImageViewer::loadDisplayProfile()
+{
+    // Qt cannot ask the system for the monitor profile, so it is chosen
+    // once by the user and remembered
+    const QString path = QSettings().value(DisplayProfileKey).toString();
+    if (path.isEmpty()) {
+        return;
+    }
+
+    const QColorSpace space = readIccProfile(path);
+    if (space.isValid()) {
+        m_renderer->setDisplayColorSpace(space);
+    } else {
+        qDebug() << "Ignoring unusable display profile:" << path;
+    }
+}
+
+void ImageViewer::onDisplayProfileClicked()
+{
+    const QString path = QFileDialog::getOpenFileName(
+        this, tr("Choose Display Profile"), QString(),
+        tr("ICC profiles (*.icc *.icm)"));
+    if (path.isEmpty()) {
+        return;
+    }
+
+    const QColorSpace space = readIccProfile(path);
+    if (!space.isValid()) {
+        QMessageBox::warning(this, tr("Display Profile"),
+                             tr("%1 is not a usable RGB display profile.")
+                                 .arg(QFileInfo(path).fileName()));
+        return;
+    }
+
+    QSettings().setValue(DisplayProfileKey, path);
+    m_renderer->setDisplayColorSpace(space);
+    m_player->setDisplayColorSpace(space);
+    if (!m_player->isPlaying()) {
+        renderCurrentImage();
+    }
+}
+
+void ImageViewer::onUseSrgbDisplayClicked()
+{
+    QSettings().remove(DisplayProfileKey);
+    m_renderer->setDisplayColorSpace(QColorSpace(QColorSpace::SRgb));
+    m_player->setDisplayColorSpace(QColorSpace(QColorSpace::SRgb));
+    if (!m_player->isPlaying()) {
+        renderCurrentImage();
+    }
+}
+
+void ImageViewer::onFindDuplicatesClicked()
+{
+    if (m_images.isEmpty() || m_duplicateFinder->isRunning()) {
+        return;
+    }
+
+    m_duplicateScanPaths.clear();
+    for (const ImageItem &imgItem : m_images) {
+        m_duplicateScanPaths << imgItem.sourcePath();
+    }
+
+    if (!m_duplicateProgress) {
+        m_duplicateProgress = new QProgressDialog(this);
+        m_duplicateProgress->setWindowTitle(tr("Find Duplicates"));
+        m_duplicateProgress->setAutoClose(false);
+        m_duplicateProgress->setAutoReset(false);
+        m_duplicateProgress->setMinimumDuration(0);
+        connect(m_duplicateProgress, &QProgressDialog::canceled,
+                m_duplicateFinder, &DuplicateFinder::cancel);
+    }
+    m_duplicateProgress->setLabelText(tr("Hashing images..."));
+    m_duplicateProgress->setRange(0, m_duplicateScanPaths.size());
+    m_duplicateProgress->setValue(0);
+    m_duplicateProgress->show();
+
+    m_duplicateFinder->start(m_folderPath, m_duplicateScanPaths);
+}
+
+void ImageViewer::onDuplicateScanProgress(int hashed, int total)
+{
+    if (m_duplicateProgress) {
+        m_duplicateProgress->setRange(0, total);
+        m_duplicateProgress->setValue(hashed);
+    }
+}
+
+void ImageViewer::onDuplicateScanFinished()
+{
+    if (m_duplicateProgress) {
+        m_duplicateProgress->hide();
+        m_duplicateProgress->reset();
+    }
+
+    // A scan cancelled by the user or by opening another folder has no result
+    if (m_duplicateFinder->wasCancelled()) {
+        return;
+    }
+
+    const QVector<QVector<int>> groups = m_duplicateFinder->groups();
+    QVector<QStringList> pathGroups;
+    for (const QVector<int> &group : groups) {
+        QStringList paths;
+        for (int i : group) {
+            paths << m_duplicateScanPaths[i];
+        }
+        pathGroups.push_back(paths);
+    }
+
+    auto *dialog = new DuplicatesDialog(pathGroups, this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    connect(dialog, &DuplicatesDialog::imageActivated, this, [this](const QString &path) {
+        for (int i = 0; i < m_images.size(); ++i) {
+            if (m_images[i].sourcePath() == path) {
+                selectImage(i);
+                return;
+            }
+        }
+    });
+    dialog->show();
+}
+
+void ImageViewer::selectImage(int imageIndex)
+{
+    if (imageIndex < 0 || imageIndex >= m_listItems.size()) {
+        return;
+    }
+
+    QListWidgetItem *item = m_listItems[imageIndex];
+    item->setHidden(false);
+    ui->folderListWidget->setCurrentItem(item);
+    onImageSelected(item);
+}
+
 void ImageViewer::setupLayout()
 {
     ui->centralwidget->setStyleSheet(
@@ -305,8 +1279,27 @@ void ImageViewer::setupLayout()
     listTitle->setObjectName("sectionTitle");
     QLabel *listSubtitle = new QLabel("Browse the images loaded from a folder.", listCard);
     listSubtitle->setObjectName("sectionSubtitle");
+    m_sortCombo = new QComboBox(listCard);
+    m_sortCombo->addItem("Sort by name", int(MetadataField::Name));
+    m_sortCombo->addItem("Sort by capture time", int(MetadataField::CaptureTime));
+    m_sortCombo->addItem("Sort by dimensions", int(MetadataField::Dimensions));
+    m_sortCombo->addItem("Sort by format", int(MetadataField::Format));
+    m_sortCombo->addItem("Sort by camera", int(MetadataField::Camera));
+    m_sortCombo->addItem("Sort by orientation", int(MetadataField::Orientation));
+
+    m_filterEdit = new QLineEdit(listCard);
+    m_filterEdit->setPlaceholderText("Filter by name, camera, format, size or date");
+    m_filterEdit->setClearButtonEnabled(true);
+
+    connect(m_sortCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &ImageViewer::applySort);
+    connect(m_filterEdit, &QLineEdit::textChanged,
+            this, &ImageViewer::applyFilter);
+
     listLayout->addWidget(listTitle);
     listLayout->addWidget(listSubtitle);
+    listLayout->addWidget(m_sortCombo);
+    listLayout->addWidget(m_filterEdit);
     listLayout->addWidget(ui->folderListWidget, 1);
 
     QFrame *previewCard = new QFrame(ui->centralwidget);
@@ -351,7 +1344,7 @@ void ImageViewer::setupLayout()
     m_histogramWidget = new HistogramWidget(histogramGroup);
     histogramLayout->addWidget(m_histogramWidget);
 
-    auto *adjustmentsGroup = new QGroupBox("Brightness & Contrast", ui->propertiesPanel);
+    auto *adjustmentsGroup = new QGroupBox("Adjustments", ui->propertiesPanel);
     m_adjustmentsLayout = new QVBoxLayout(adjustmentsGroup);
     m_adjustmentsLayout->setContentsMargins(12, 12, 12, 12);
     m_adjustmentsLayout->setSpacing(10);
@@ -370,9 +1363,12 @@ void ImageViewer::setupLayout()
 void ImageViewer::setupImageListStyle()
 {
     ui->folderListWidget->setViewMode(QListView::ListMode);
+    ui->folderListWidget->setSelectionMode(QAbstractItemView::ExtendedSelection);
     ui->folderListWidget->setIconSize(QSize(56, 56));
     ui->folderListWidget->setSpacing(8);
-    ui->folderListWidget->setUniformItemSizes(false);
+    // Every row is the same height; lets the view lay out large folders
+    // without measuring each row
+    ui->folderListWidget->setUniformItemSizes(true);
     ui->folderListWidget->setStyleSheet(
         "QListWidget {"
         "  border: none;"
@@ -406,7 +1402,7 @@ void ImageViewer::showPropertiesEmptyState()
         m_histogramWidget->clear();
     }
 
-    m_adjustmentsHintLabel = new QLabel("Select an image to enable brightness and contrast controls.", ui->propertiesPanel);
+    m_adjustmentsHintLabel = new QLabel("Select an image to enable the adjustment controls.", ui->propertiesPanel);
     m_adjustmentsHintLabel->setWordWrap(true);
     m_adjustmentsHintLabel->setStyleSheet("QLabel { color: #64748b; background: transparent; }");
     m_adjustmentsLayout->addWidget(m_adjustmentsHintLabel);
@@ -417,25 +1413,108 @@ void ImageViewer::resizeEvent(QResizeEvent *event)
 {
     QMainWindow::resizeEvent(event);
 
-    if (m_currentImageIndex >= 0 && m_currentImageIndex < m_images.size()) {
-        const QImage &img = m_images[m_currentImageIndex].editedImage();
-        if (!img.isNull()) {
-            updateDisplayedImage(img);
+    // A playing animation repaints at the new size with its next frame
+    if (m_player->isPlaying()) {
+        return;
+    }
+
+    renderCurrentImage();
+}
+
+bool ImageViewer::eventFilter(QObject *watched, QEvent *event)
+{
+    // Animations always show the whole frame
+    if (watched != ui->imageLabel || m_player->isPlaying()) {
+        return QMainWindow::eventFilter(watched, event);
+    }
+
+    switch (event->type()) {
+    case QEvent::Wheel: {
+        auto *wheel = static_cast<QWheelEvent *>(event);
+        const int steps = wheel->angleDelta().y() / 120;
+        if (steps != 0) {
+            zoomAt(std::pow(1.25, steps), wheel->position());
+        }
+        return true;
+    }
+    case QEvent::MouseButtonPress: {
+        auto *mouse = static_cast<QMouseEvent *>(event);
+        if (mouse->button() == Qt::LeftButton && m_zoom > 1.0) {
+            m_panning = true;
+            m_panOrigin = mouse->pos();
+            m_panCentre = m_viewCentre;
+            ui->imageLabel->setCursor(Qt::ClosedHandCursor);
+            return true;
         }
+        break;
     }
+    case QEvent::MouseMove:
+        if (m_panning) {
+            panBy(static_cast<QMouseEvent *>(event)->pos() - m_panOrigin);
+            return true;
+        }
+        break;
+    case QEvent::MouseButtonRelease:
+        if (m_panning) {
+            m_panning = false;
+            ui->imageLabel->unsetCursor();
+            return true;
+        }
+        break;
+    case QEvent::MouseButtonDblClick:
+        m_zoom = 1.0;
+        m_viewCentre = QPointF(0.5, 0.5);
+        renderCurrentImage();
+        return true;
+    default:
+        break;
+    }
+    return QMainWindow::eventFilter(watched, event);
 }
 
-void ImageViewer::updateDisplayedImage(const QImage &image)
+void ImageViewer::updateDisplayedImage(const QImage &image, const QRectF &sourceRect)
 {
-    QPixmap pix = QPixmap::fromImage(image);
-    ui->imageLabel->setText(QString());
-    ui->imageLabel->setPixmap(
-        pix.scaled(ui->imageLabel->size(),
-                   Qt::KeepAspectRatio,
-                   Qt::SmoothTransformation)
-        );
+    const QRectF source = sourceRect.isNull() ? QRectF(image.rect()) : sourceRect;
+    const QSize target = source.size().scaled(ui->imageLabel->size(),
+                                              Qt::KeepAspectRatio).toSize();
+    if (target.isEmpty()) {
+        return;
+    }
 
-    if (m_histogramWidget) {
-        m_histogramWidget->setImage(image);
+    // The label shares the pixmap it shows; let go of it so the pooled
+    // display pixmap can be painted into without being copied first
+    ui->imageLabel->clear();
+    m_framePool.prepare(m_displayPixmap, target);
+
+    if (image.hasAlphaChannel()) {
+        m_displayPixmap.fill(Qt::transparent);
+    }
+
+    // High-bit-depth images are reduced to the screen format only here,
+    // into a pooled buffer, so the painter scales without converting
+    const QImage *frame = &image;
+    QRectF frameSource = source;
+    if (image.depth() > 32) {
+        const QRect area = source.toAlignedRect() & image.rect();
+        m_framePool.prepare(m_displayBuffer, area.size(), QImage::Format_ARGB32_Premultiplied);
+        ImageProcessor::convertForDisplay(image, area, m_displayBuffer);
+        frame = &m_displayBuffer;
+        frameSource = source.translated(-area.topLeft());
+    } else if (!m_displayBuffer.isNull()) {
+        m_framePool.recycle(m_displayBuffer);
+    }
+
+    {
+        QPainter painter(&m_displayPixmap);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+        painter.drawImage(QRectF(m_displayPixmap.rect()), *frame, frameSource);
+    }
+    ui->imageLabel->setPixmap(m_displayPixmap);
+    m_memory.touch(m_displayCache, 0,
+                   qint64(m_displayPixmap.width()) * m_displayPixmap.height() *
+                   m_displayPixmap.depth() / 8 + m_displayBuffer.sizeInBytes());
+
+    if (m_sliderDragging && ++m_dragFrames == 1) {
+        m_dragAllocations = m_framePool.allocations();
     }
 }
@@ -4,15 +4,24 @@
 #include <QMainWindow>
 #include <QListWidgetItem>
 #include <QImage>
+#include <QHash>
+#include <QPointF>
 #include <QVector>
 #include <QVBoxLayout>
 #include <QSlider>
 #include <QLabel>
 #include <QGroupBox>
+#include <QTimer>
 
+#include "AutoAdjust.h"
+#include "DuplicateFinder.h"
+#include "FrameBufferPool.h"
 #include "HistogramWidget.h"
+#include "ImageExporter.h"
 #include "ImageItem.h"
 #include "ImageProcessor.h"
+#include "MemoryManager.h"
+#include "MetadataIndex.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -20,7 +29,16 @@ class ImageViewer;
 }
 QT_END_NAMESPACE
 
+class QComboBox;
+class QLineEdit;
+class QProgressDialog;
+class AnimationPlayer;
+class MemoryDialog;
+class HistogramLoader;
+class MetadataLoader;
+class ProgressiveRenderer;
 class QResizeEvent;
+class ThumbnailLoader;
 
 class ImageViewer : public QMainWindow
 {
@@ -30,15 +48,34 @@ public:
     ImageViewer(QWidget *parent = nullptr);
     ~ImageViewer();
 
+    const FrameBufferPool &framePool() const { return m_framePool; }
+
 private:
     Ui::ImageViewer *ui;
     QVector<ImageItem> m_images;
+    QVector<ImageMetadata> m_metadata;       // parallel to m_images
+    QVector<QListWidgetItem*> m_listItems;  // parallel to m_images
+
+    // Thumbnails the memory manager dropped are decoded again once their
+    // row scrolls back into view
+    enum class ThumbnailState : quint8 { Pending, Loaded, Evicted };
+    QVector<ThumbnailState> m_thumbnailStates;  // parallel to m_images
+    QTimer m_thumbnailRestoreTimer;
     int m_currentImageIndex = -1;
 
     QVBoxLayout *m_propertiesLayout = nullptr;
     QVBoxLayout *m_adjustmentsLayout = nullptr;
     HistogramWidget *m_histogramWidget = nullptr;
     QLabel *m_adjustmentsHintLabel = nullptr;
+    QComboBox *m_sortCombo = nullptr;
+    MetadataField m_sortField = MetadataField::Name;
+    QLineEdit *m_filterEdit = nullptr;
+    ThumbnailLoader *m_thumbnailLoader = nullptr;
+    MetadataLoader *m_metadataLoader = nullptr;
+    HistogramLoader *m_histogramLoader = nullptr;
+    // Auto adjustments waiting for a histogram, by image index
+    QHash<int, AutoAdjust::Mode> m_pendingAutoAdjust;
+    int m_lateAutoAdjusted = 0;
 
     struct PropertyControl {
         PropertyId id;
@@ -47,20 +84,98 @@ private:
     };
     QVector<PropertyControl> m_propertyControls;
 
+    // Accounts for the pixel memory of every cache; see registerCaches()
+    MemoryManager m_memory;
+    int m_decodedCache = -1;
+    int m_previewCache = -1;
+    int m_thumbnailCache = -1;
+    int m_spareCache = -1;
+    int m_displayCache = -1;
+    int m_animationCache = -1;
+    int m_exportCache = -1;
+    MemoryDialog *m_memoryDialog = nullptr;
+
+    FrameBufferPool m_framePool;
+    QPixmap m_displayPixmap;
+    QImage  m_displayBuffer;   // high-bit-depth frames, converted for the screen
+
+    // Render buffers must be reused while a slider is dragged: the pool's
+    // allocation count after the first frame of a drag is the baseline
+    bool    m_sliderDragging = false;
+    int     m_dragFrames = 0;
+    quint64 m_dragAllocations = 0;
+    ProgressiveRenderer *m_renderer = nullptr;
+
+    // Preview zoom and pan: 1 fits the whole image, the centre is relative
+    // to the image size so it survives a proxy being swapped in
+    double  m_zoom = 1.0;
+    QPointF m_viewCentre = QPointF(0.5, 0.5);
+    bool    m_panning = false;
+    QPoint  m_panOrigin;
+    QPointF m_panCentre;
+    AnimationPlayer *m_player = nullptr;
+
+    ImageExporter *m_exporter = nullptr;
+    QProgressDialog *m_exportProgress = nullptr;
+
+    QString m_folderPath;
+    DuplicateFinder *m_duplicateFinder = nullptr;
+    QProgressDialog *m_duplicateProgress = nullptr;
+    QStringList m_duplicateScanPaths;
+
 private slots:
     void onOpenFolderClicked();
+    void onFolderListed(int generation, int count);
+    void onMetadataReady(int generation, const QVector<ImageMetadata> &batch);
+    void onMetadataFinished(int generation);
     void onImageSelected(QListWidgetItem *item);
     void onPropertySliderChanged(int value);
+    void onPropertySliderPressed();
+    void onPropertySliderReleased();
+    void onRenderFrameReady(const QImage &image, const QRectF &sourceRect);
+    void onRenderOverviewReady(const QImage &overview);
+    void onAnimationFrameReady(const QImage &frame);
+    void onAnimationFinished();
+    void onExportClicked();
+    void onExportProgress(int value, int maximum);
+    void onExportFinished(int exported, const QStringList &errors);
+    void onExportMemoryChanged(qint64 bytes);
+    void onThumbnailReady(int generation, int imageIndex, const QImage &thumbnail,
+                          const HistogramStats &histogram);
+    void onHistogramReady(int generation, int imageIndex, const HistogramStats &histogram);
+    void onFindDuplicatesClicked();
+    void onDuplicateScanProgress(int hashed, int total);
+    void onDuplicateScanFinished();
+    void onMemoryUsageClicked();
+    void onDisplayProfileClicked();
+    void onUseSrgbDisplayClicked();
+    void autoAdjustSelection(AutoAdjust::Mode mode);
+    void applyAutoAdjust(int imageIndex, AutoAdjust::Mode mode);
 
 private:
+    void applySort();
+    void applyFilter();
+    void startThumbnails();
+    void restoreThumbnails();
+    bool isRowVisible(const QListWidgetItem *item) const;
+    void registerCaches();
+    void loadDisplayProfile();
+    void selectImage(int imageIndex);
     void rebuildPropertiesUI(ImageItem &item);
     void clearPropertiesUI();
-    void updateDisplayedImage(const QImage &image);
+    void buildPyramid(int imageIndex);
+    void renderCurrentImage();
+    QRectF visibleImageRect(const ImageItem &item) const;
+    QRectF displayedRect(const QRectF &visible) const;
+    void zoomAt(double factor, const QPointF &labelPos);
+    void panBy(const QPoint &delta);
+    void updateDisplayedImage(const QImage &image, const QRectF &sourceRect = QRectF());
     void setupLayout();
     void setupImageListStyle();
     void showPropertiesEmptyState();
 
 protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
 };
 